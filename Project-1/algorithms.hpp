@@ -11,10 +11,24 @@
 
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <limits>
 #include <optional>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
+#include "cpu_dispatch.hpp"
+#include "fixed_size.hpp"
+#include "huge_buffer.hpp"
+#include "result_cache.hpp"
+
 namespace algorithms {
 
 // A "dip" is a series of three elements in a row, where the first and third
@@ -54,6 +68,364 @@ std::vector<int>::const_iterator find_dip(const std::vector<int>& values) {
   }
 
 }
+
+// Find the last dip in a fixed-size array, with the same contract as
+// find_dip. The number of three-element windows is a compile-time constant,
+// so the compiler can unroll the scan. Windows are checked from the back, so
+// the search stops at the last dip. Usable in constexpr contexts.
+template <size_t N>
+constexpr typename std::array<int, N>::const_iterator
+find_dip(const std::array<int, N>& values) {
+  if constexpr (N < 3) {
+    return values.cend();
+  } else {
+    for (size_t i = N - 2; i-- > 0; ) {
+      if ((values[i] == values[i + 2]) && (values[i + 1] < values[i])) {
+        return values.cbegin() + i;
+      }
+    }
+    return values.cend();
+  }
+}
+
+// Largest input routed to the fixed-size find_dip by find_dip_auto.
+constexpr size_t find_dip_fixed_limit = 16;
+
+// Compute the same result as find_dip, routing inputs of at most
+// find_dip_fixed_limit elements to the fixed-size scan.
+std::vector<int>::const_iterator find_dip_auto(const std::vector<int>& values) {
+  if (values.size() > find_dip_fixed_limit) {
+    return find_dip(values);
+  }
+  if (values.empty()) {
+    return values.cend();
+  }
+  size_t index = fixed_size::call<1, find_dip_fixed_limit>(
+    values, [](const auto& copy) -> size_t { return find_dip(copy) - copy.cbegin(); });
+  return values.cbegin() + index;
+}
+
+// Instruction set variants of the find_dip scan, for find_dip_vector. Each
+// returns the index of the last dip in values[0, n), or n when there is
+// none. The vector variants test a block of consecutive windows at once,
+// starting from the back, so they stop at the block holding the last dip.
+namespace kernels {
+
+inline size_t last_dip_scalar(const int* values, size_t n) {
+  for (size_t i = (n < 3) ? 0 : n - 2; i-- > 0; ) {
+    if ((values[i] == values[i + 2]) && (values[i + 1] < values[i])) {
+      return i;
+    }
+  }
+  return n;
+}
+
+#if CPU_DISPATCH_X86
+
+// Scan the windows before i one at a time, after the blocks are exhausted.
+inline size_t last_dip_tail(const int* values, size_t n, size_t i) {
+  size_t dip = last_dip_scalar(values, std::min(n, i + 2));
+  return (dip == std::min(n, i + 2)) ? n : dip;
+}
+
+CPU_DISPATCH_TARGET_SSE42
+inline size_t last_dip_sse42(const int* values, size_t n) {
+  size_t i = (n < 3) ? 0 : n - 2;
+  for (; i >= 4; ) {
+    i -= 4;
+    __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(values + i)),
+            b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(values + i + 1)),
+            c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(values + i + 2));
+    __m128i dips = _mm_and_si128(_mm_cmpeq_epi32(a, c), _mm_cmpgt_epi32(a, b));
+    unsigned mask = _mm_movemask_ps(_mm_castsi128_ps(dips));
+    if (mask) {
+      return i + 31 - __builtin_clz(mask);
+    }
+  }
+  return last_dip_tail(values, n, i);
+}
+
+CPU_DISPATCH_TARGET_AVX2
+inline size_t last_dip_avx2(const int* values, size_t n) {
+  size_t i = (n < 3) ? 0 : n - 2;
+  for (; i >= 8; ) {
+    i -= 8;
+    __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + i)),
+            b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + i + 1)),
+            c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + i + 2));
+    __m256i dips = _mm256_and_si256(_mm256_cmpeq_epi32(a, c), _mm256_cmpgt_epi32(a, b));
+    unsigned mask = _mm256_movemask_ps(_mm256_castsi256_ps(dips));
+    if (mask) {
+      return i + 31 - __builtin_clz(mask);
+    }
+  }
+  return last_dip_tail(values, n, i);
+}
+
+CPU_DISPATCH_TARGET_AVX512
+inline size_t last_dip_avx512(const int* values, size_t n) {
+  size_t i = (n < 3) ? 0 : n - 2;
+  for (; i >= 16; ) {
+    i -= 16;
+    __m512i a = _mm512_loadu_si512(values + i),
+            b = _mm512_loadu_si512(values + i + 1),
+            c = _mm512_loadu_si512(values + i + 2);
+    unsigned mask = _mm512_mask_cmpgt_epi32_mask(_mm512_cmpeq_epi32_mask(a, c), a, b);
+    if (mask) {
+      return i + 31 - __builtin_clz(mask);
+    }
+  }
+  return last_dip_tail(values, n, i);
+}
+
+#endif
+
+// The last_dip variant for the instruction set level cpu_dispatch::active()
+// selects.
+inline auto last_dip() {
+  using kernel = size_t (*)(const int*, size_t);
+#if CPU_DISPATCH_X86
+  return cpu_dispatch::select<kernel>(last_dip_scalar, last_dip_sse42,
+                                      last_dip_avx2, last_dip_avx512);
+#else
+  return kernel(last_dip_scalar);
+#endif
+}
+
+}
+
+// Compute the same result as find_dip, with the scan compiled for the
+// instruction set level cpu_dispatch::active() selects.
+std::vector<int>::const_iterator find_dip_vector(const std::vector<int>& values) {
+  return values.cbegin() + kernels::last_dip()(values.data(), values.size());
+}
+
+// Find the last dip in values[0, n) with one thread per partition of
+// numa::for_each_partition(n, threads), returning its index, or n when
+// there is none. Each thread scans the windows starting in its partition,
+// reading at most two elements past it, with the find_dip_vector kernel.
+// When values is a HugeBuffer initialized with the same number of threads,
+// every thread reads memory on its own NUMA node.
+size_t find_dip_parallel(const int* values, size_t n,
+                         unsigned threads = std::thread::hardware_concurrency()) {
+  threads = std::max(1u, threads);
+  const auto scan = kernels::last_dip();
+  std::vector<size_t> last(threads, n);
+  numa::for_each_partition(n, threads, [&](unsigned thread, size_t begin, size_t end) {
+    const size_t stop = std::min(n, end + 2);
+    if (stop >= begin + 3) {
+      size_t dip = scan(values + begin, stop - begin);
+      if (dip != stop - begin) {
+        last[thread] = begin + dip;
+      }
+    }
+  });
+  for (size_t thread = threads; thread-- > 0; ) {
+    if (last[thread] != n) {
+      return last[thread];
+    }
+  }
+  return n;
+}
+
+// Compute the same result as find_dip, with find_dip_parallel.
+std::vector<int>::const_iterator
+find_dip_parallel(const std::vector<int>& values,
+                  unsigned threads = std::thread::hardware_concurrency()) {
+  return values.cbegin() + find_dip_parallel(values.data(), values.size(), threads);
+}
+
+// A dip index maintains the positions of every dip in a mutable vector, so
+// that the last dip can be found after each change without rescanning.
+//
+// Position i is a dip start when values[i], values[i+1], values[i+2] form a
+// dip. Changing values[i] can only affect the dip starts at i-2, i-1, and i,
+// so set, push_back, and pop_back each recheck at most three positions.
+//
+// Dip starts are stored as a bitmap of 64-bit words, with a hierarchy of
+// summary levels above it: bit w of level L+1 is set when word w of level L
+// is nonzero, and the top level is a single word. A predecessor query
+// climbs the levels until it finds a set bit before the query position, then
+// descends along the highest set bits, so queries touch a handful of words
+// (one per level, about log64(n) of them). Updates only propagate upward
+// when a word changes between zero and nonzero.
+class dip_index {
+private:
+  std::vector<int> values_;
+  std::vector<std::vector<uint64_t>> levels_;
+  size_t count_;
+
+  static constexpr size_t word_bits = 64;
+
+  // Index of the highest set bit in word, which must be nonzero.
+  static size_t highest_bit(uint64_t word) {
+    return word_bits - 1 - __builtin_clzll(word);
+  }
+
+  // Grow the levels to hold one bit per element of values_.
+  void reserve_bits() {
+    size_t words = std::max<size_t>(1, (values_.size() + word_bits - 1) / word_bits);
+    for (size_t level = 0; ; ++level) {
+      if (level == levels_.size()) {
+        // summarize the level below, whose bits may already be set
+        levels_.emplace_back(words, 0);
+        const auto& below = levels_[level - 1];
+        for (size_t w = 0; w < below.size(); ++w) {
+          if (below[w]) {
+            levels_[level][w / word_bits] |= uint64_t(1) << (w % word_bits);
+          }
+        }
+      } else if (levels_[level].size() < words) {
+        levels_[level].resize(words, 0);
+      }
+      if (words == 1) {
+        break;
+      }
+      words = (words + word_bits - 1) / word_bits;
+    }
+  }
+
+  // Set or clear bit position, propagating to the summary levels.
+  void assign_bit(size_t position, bool set) {
+    for (size_t level = 0; level < levels_.size(); ++level) {
+      uint64_t& word = levels_[level][position / word_bits];
+      const uint64_t bit = uint64_t(1) << (position % word_bits);
+      const bool was_empty = (word == 0);
+      word = set ? (word | bit) : (word & ~bit);
+      // the level above only changes when this word becomes empty or nonempty
+      if (was_empty == (word == 0)) {
+        break;
+      }
+      position /= word_bits;
+    }
+  }
+
+  // Recheck whether a dip starts at position.
+  void refresh(size_t position) {
+    const bool dip = (position + 2 < values_.size()) &&
+                     (values_[position] == values_[position + 2]) &&
+                     (values_[position + 1] < values_[position]);
+    if (dip != is_dip(position)) {
+      assign_bit(position, dip);
+      count_ += dip ? 1 : -1;
+    }
+  }
+
+  // Recheck the dip starts affected by a change to values_[position].
+  void refresh_around(size_t position) {
+    for (size_t i = (position < 2) ? 0 : position - 2; i <= position; ++i) {
+      refresh(i);
+    }
+  }
+
+public:
+
+  // Create an empty index.
+  dip_index() : levels_{{0}}, count_(0) {}
+
+  // Create an index of values, in O(n) time.
+  explicit dip_index(std::vector<int> values)
+  : values_(std::move(values)), levels_{{0}}, count_(0) {
+    reserve_bits();
+    for (size_t i = 0; i < values_.size(); ++i) {
+      refresh(i);
+    }
+  }
+
+  // Accessors.
+  const std::vector<int>& values() const { return values_; }
+  size_t size() const { return values_.size(); }
+
+  // Whether a dip starts at position.
+  bool is_dip(size_t position) const {
+    const auto& bits = levels_.front();
+    return (position / word_bits < bits.size()) &&
+           ((bits[position / word_bits] >> (position % word_bits)) & 1);
+  }
+
+  // Total number of dips.
+  size_t count() const { return count_; }
+
+  // Replace values[position] with value. position must be less than size().
+  void set(size_t position, int value) {
+    assert(position < values_.size());
+    values_[position] = value;
+    refresh_around(position);
+  }
+
+  // Append value to the end of values.
+  void push_back(int value) {
+    values_.push_back(value);
+    reserve_bits();
+    refresh_around(values_.size() - 1);
+  }
+
+  // Remove the last element of values, which must not be empty.
+  void pop_back() {
+    assert(!values_.empty());
+    values_.pop_back();
+    // only the dip starting at the new size - 2 can lose its third element
+    if (values_.size() >= 2) {
+      refresh(values_.size() - 2);
+    }
+  }
+
+  // The start of the last dip that begins before position, if any.
+  std::optional<size_t> last_dip_before(size_t position) const {
+    size_t level = 0;
+    // climb until some word has a set bit before position
+    for (; ; ++level) {
+      if (level == levels_.size()) {
+        return std::nullopt;
+      }
+      const auto& words = levels_[level];
+      size_t word = position / word_bits, bit = position % word_bits;
+      if (word >= words.size()) {
+        word = words.size() - 1;
+        bit = word_bits;
+      }
+      const uint64_t below =
+        words[word] & ((bit == word_bits) ? ~uint64_t(0) : (uint64_t(1) << bit) - 1);
+      if (below) {
+        position = word * word_bits + highest_bit(below);
+        break;
+      }
+      position = word;
+    }
+    // descend along the highest set bits
+    while (level-- > 0) {
+      position = position * word_bits + highest_bit(levels_[level][position]);
+    }
+    return position;
+  }
+
+  // The start of the last dip, if any.
+  std::optional<size_t> last_dip() const {
+    return last_dip_before(values_.size());
+  }
+
+  // The start of the last dip lying entirely within values[begin, end), if
+  // any.
+  std::optional<size_t> last_dip_in(size_t begin, size_t end) const {
+    if (end < begin + 3) {
+      return std::nullopt;
+    }
+    auto dip = last_dip_before(end - 2);
+    return (dip && *dip >= begin) ? dip : std::nullopt;
+  }
+
+  // Convert a dip position from this index to the iterator find_dip would
+  // return, values().cend() when there is no dip. The iterator is
+  // invalidated by push_back and pop_back.
+  std::vector<int>::const_iterator to_iterator(std::optional<size_t> dip) const {
+    return dip ? (values_.cbegin() + *dip) : values_.cend();
+  }
+
+  // Compute the same result as find_dip(values()).
+  std::vector<int>::const_iterator find_dip() const {
+    return to_iterator(last_dip());
+  }
+};
   
 
 // A span represents a non-empty range of indices inside of a vector of ints,
@@ -88,6 +460,65 @@ public:
   size_t size() const { return end_ - begin_; }
 };
 
+// A compact alternative to span, storing the range as unsigned offsets into
+// the vector instead of iterators. With a 32-bit Offset the whole span is 8
+// bytes. It is trivially copyable and not tied to any particular vector
+// object, so spans can be stored densely in flat arrays, written to files or
+// shared memory as raw bytes, and read back without pointer fixups. Offset
+// must be an unsigned integer type, normally uint32_t or uint64_t.
+//
+// The default constructor makes an empty placeholder, so that arrays of spans
+// can be allocated before they are filled in. Every other span is non-empty.
+template <typename Offset>
+class offset_span {
+  static_assert(std::is_unsigned_v<Offset>, "Offset must be unsigned");
+
+private:
+  Offset begin_, end_;
+
+public:
+
+  constexpr offset_span() : begin_(0), end_(0) {}
+
+  // Create a span from two offsets. begin must come before end.
+  constexpr offset_span(Offset begin, Offset end)
+  : begin_(begin), end_(end) {
+    assert(begin < end);
+  }
+
+  // Convert from a span with iterators into values.
+  offset_span(const span& s, const std::vector<int>& values)
+  : offset_span(Offset(s.begin() - values.begin()), Offset(s.end() - values.begin())) {
+    assert(size_t(s.end() - values.begin()) <= std::numeric_limits<Offset>::max());
+  }
+
+  // Convert to a span with iterators into values, which must be the vector
+  // the offsets refer to.
+  span to_span(const std::vector<int>& values) const {
+    assert(end_ <= values.size());
+    return span(values.begin() + begin_, values.begin() + end_);
+  }
+
+  // Equality tests, two spans are equal when each of their offsets are equal.
+  constexpr bool operator== (const offset_span& rhs) const {
+    return (begin_ == rhs.begin_) && (end_ == rhs.end_);
+  }
+
+  // Accessors.
+  constexpr Offset begin() const { return begin_; }
+  constexpr Offset end  () const { return end_  ; }
+
+  // Compute the number of elements in the span.
+  constexpr size_t size() const { return end_ - begin_; }
+};
+
+using offset_span32 = offset_span<uint32_t>;
+using offset_span64 = offset_span<uint64_t>;
+
+static_assert(sizeof(offset_span32) == 8);
+static_assert(std::is_trivially_copyable_v<offset_span32>);
+static_assert(std::is_trivially_copyable_v<offset_span64>);
+
 // Find the longest "balanced" span in values.
 //
 // A span is balanced when its sum is zero. For example, the elements
@@ -121,12 +552,37 @@ std::optional<span> longest_balanced_span(const std::vector<int>& values) {
           best = span(start, end);
         }
       }
-      sum +=values[e];
+      if(e < values.size()){
+        sum +=values[e];
+      }
     }
   }
   return best;
 }
 
+// Results of longest_balanced_span, stored as offsets so that they apply to
+// any vector with the same contents.
+using balanced_span_cache = result_cache::ResultCache<std::optional<offset_span64>>;
+
+// Compute the same result as longest_balanced_span, answering repeated
+// queries for the same contents from cache.
+std::optional<span> longest_balanced_span_memo(const std::vector<int>& values,
+                                               balanced_span_cache& cache) {
+  result_cache::CacheKey key =
+    result_cache::KeyHasher("longest_balanced_span").add_array(values).key();
+  auto offsets = cache.get_or_compute(key, [&]() -> std::optional<offset_span64> {
+    auto best = longest_balanced_span(values);
+    if (!best) {
+      return std::nullopt;
+    }
+    return offset_span64(*best, values);
+  });
+  if (!offsets) {
+    return std::nullopt;
+  }
+  return offsets->to_span(values);
+}
+
 // A "telegraph-style" string is suitable for transmission via
 // telegram. This function takes a string s as input, and returns a
 // version of the string converted to telegraph-style.
@@ -164,7 +620,7 @@ std::string telegraph_style(const std::string& s) {
     else if(isdigit(s[i]) || s[i] == '.' || (s[i] >= 'A' && s[i] <= 'Z')){
       new_str.push_back(s[i]);
     }else if(s[i] == ' '){
-      if(new_str.back() !=' '){
+      if(new_str.empty() || new_str.back() !=' '){
         new_str.push_back(' ');
       }
     }
@@ -182,4 +638,146 @@ std::string telegraph_style(const std::string& s) {
   }
   return new_str;
 }
+
+// Convert one character the way telegraph_style does, without collapsing
+// spaces. Returns 0 when c is removed.
+inline char telegraph_char(char c) {
+  if (c >= 'a' && c <= 'z') {
+    return c - 'a' + 'A';
+  }
+  if (c == '!' || c == '?' || c == ';') {
+    return '.';
+  }
+  if ((c >= '0' && c <= '9') || (c >= 'A' && c <= 'Z') || c == '.' || c == ' ') {
+    return c;
+  }
+  return 0;
+}
+
+// Smallest chunk of input worth a thread of its own.
+constexpr size_t telegraph_min_chunk = size_t(1) << 16;
+
+// The telegraph-style version of a string, computed in parallel and held as
+// a list of pieces whose concatenation is exactly telegraph_style(s).
+//
+// The input is split into one contiguous chunk per thread, and each chunk is
+// converted into its own buffer, collapsing spaces as if it were the start
+// of the input. The seams are then reconciled in order: when a buffer starts
+// with a space and the output before it ends with one, that space is
+// skipped. Piece offsets are a prefix sum over the buffer sizes, and
+// whether "STOP." is appended is decided once, from the last five output
+// characters.
+//
+// The pieces can be written without copying (e.g. one iovec per piece for
+// writev), or joined into one string with str(), which copies every piece
+// to its offset in parallel.
+class telegraph_chunks {
+private:
+  std::vector<std::string> buffers_;
+  std::vector<size_t> skips_, offsets_;
+  bool stop_ = false;
+
+  static constexpr std::string_view suffix = "STOP.";
+
+  // Call f(i) for every i in [0, count), each on its own thread.
+  template <typename Function>
+  static void parallel_for(size_t count, Function f) {
+    std::vector<std::thread> pool;
+    for (size_t i = 1; i < count; ++i) {
+      pool.emplace_back(f, i);
+    }
+    if (count > 0) {
+      f(0);
+    }
+    for (auto& thread : pool) {
+      thread.join();
+    }
+  }
+
+public:
+
+  // Convert s using up to threads threads, giving each at least min_chunk
+  // characters.
+  explicit telegraph_chunks(const std::string& s,
+                            unsigned threads = std::thread::hardware_concurrency(),
+                            size_t min_chunk = telegraph_min_chunk) {
+    const size_t n = s.size();
+    const size_t chunks = std::max<size_t>(
+      1, std::min<size_t>(threads, (n + min_chunk - 1) / std::max<size_t>(min_chunk, 1)));
+
+    buffers_.resize(chunks);
+    parallel_for(chunks, [&](size_t i) {
+      const size_t begin = n * i / chunks, end = n * (i + 1) / chunks;
+      std::string& out = buffers_[i];
+      out.reserve(end - begin);
+      for (size_t j = begin; j < end; ++j) {
+        char c = telegraph_char(s[j]);
+        if (c && !(c == ' ' && !out.empty() && out.back() == ' ')) {
+          out.push_back(c);
+        }
+      }
+    });
+
+    // reconcile the seams and lay out the pieces
+    skips_.resize(chunks);
+    offsets_.resize(chunks + 1);
+    char last = 0;
+    for (size_t i = 0; i < chunks; ++i) {
+      const std::string& buffer = buffers_[i];
+      skips_[i] = (!buffer.empty() && buffer.front() == ' ' && last == ' ') ? 1 : 0;
+      if (buffer.size() > skips_[i]) {
+        last = buffer.back();
+      }
+      offsets_[i + 1] = offsets_[i] + (buffer.size() - skips_[i]);
+    }
+
+    // gather the last characters of the output, which may span pieces
+    std::string tail;
+    for (size_t i = chunks; i-- > 0 && tail.size() < suffix.size(); ) {
+      std::string_view p = piece(i);
+      size_t take = std::min(p.size(), suffix.size() - tail.size());
+      tail.insert(0, p.substr(p.size() - take));
+    }
+    stop_ = (tail != suffix);
+  }
+
+  // Number of pieces, including the "STOP." suffix when it is appended.
+  size_t pieces() const { return buffers_.size() + (stop_ ? 1 : 0); }
+
+  // The characters of piece i. Views remain valid for the lifetime of this
+  // object.
+  std::string_view piece(size_t i) const {
+    assert(i < pieces());
+    if (i == buffers_.size()) {
+      return suffix;
+    }
+    return std::string_view(buffers_[i]).substr(skips_[i]);
+  }
+
+  // Offset of piece i in the output.
+  size_t offset(size_t i) const {
+    assert(i < pieces());
+    return offsets_[i];
+  }
+
+  // Total length of the output.
+  size_t size() const { return offsets_.back() + (stop_ ? suffix.size() : 0); }
+
+  // Join the pieces into one string.
+  std::string str() const {
+    std::string out(size(), '\0');
+    parallel_for(pieces(), [&](size_t i) {
+      std::string_view p = piece(i);
+      std::copy(p.begin(), p.end(), out.begin() + offset(i));
+    });
+    return out;
+  }
+};
+
+// Compute the same result as telegraph_style, converting chunks of s in
+// parallel. See telegraph_chunks.
+std::string telegraph_style_parallel(const std::string& s,
+                                     unsigned threads = std::thread::hardware_concurrency()) {
+  return telegraph_chunks(s, threads).str();
+}
 }
@@ -0,0 +1,172 @@
+///////////////////////////////////////////////////////////////////////////////
+// algorithms_fuzz.cpp
+//
+// Differential fuzzing for the functions in algorithms.hpp. Every input is
+// given to each reference function and to each of its faster counterparts,
+// and the results must be identical, including which of several equally
+// good answers is chosen. The running time of every engine is accumulated,
+// so performance regressions show up alongside divergences.
+//
+// Built two ways:
+//
+// - With -DUSE_LIBFUZZER -fsanitize=fuzzer, as a libFuzzer target that
+//   decodes arbitrary bytes into inputs.
+// - Otherwise, as a standalone property-based test that feeds random bytes
+//   and every distribution from workloads.hpp at several sizes, then prints
+//   the time spent in each engine. Usage: algorithms_fuzz [iterations [seed]]
+//
+// The Makefile builds both under AddressSanitizer and
+// UndefinedBehaviorSanitizer, so that an engine reading out of bounds or
+// overflowing fails even when its result happens to agree.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <numeric>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "timer.hpp"
+#include "workloads.hpp"
+
+#include "algorithms.hpp"
+
+// Total seconds spent in each engine, by name.
+std::map<std::string, double> engine_seconds;
+
+// Run engine, charging its running time to name.
+template <typename Engine>
+auto timed(const std::string& name, Engine engine) {
+  Timer timer;
+  auto result = engine();
+  engine_seconds[name] += timer.elapsed();
+  return result;
+}
+
+// Abort with a description when an engine disagrees with its reference.
+void expect(bool agrees, const std::string& engine, size_t input_size) {
+  if (!agrees) {
+    std::cerr << "MISMATCH: " << engine << " disagrees with its reference on an input of size "
+              << input_size << std::endl;
+    std::abort();
+  }
+}
+
+void check_find_dip(const std::vector<int>& values) {
+  auto expected = timed("find_dip", [&] { return algorithms::find_dip(values); });
+  expect(expected == timed("find_dip_auto", [&] { return algorithms::find_dip_auto(values); }),
+         "find_dip_auto", values.size());
+  expect(expected == timed("find_dip_parallel",
+                           [&] { return algorithms::find_dip_parallel(values, 3); }),
+         "find_dip_parallel", values.size());
+  for (auto level : cpu_dispatch::supported_levels()) {
+    cpu_dispatch::ScopedLevel scope(level);
+    const std::string engine = std::string("find_dip_vector (") + cpu_dispatch::name(level) + ")";
+    expect(expected == timed(engine, [&] { return algorithms::find_dip_vector(values); }),
+           engine, values.size());
+  }
+
+  auto index = timed("dip_index (build)", [&] { return algorithms::dip_index(values); });
+  expect(expected - values.begin() == index.find_dip() - index.values().begin(),
+         "dip_index", values.size());
+
+  // remove and restore each element from the back, checking every prefix
+  std::vector<int> prefix(values);
+  while (!prefix.empty()) {
+    timed("dip_index (pop_back)", [&] { index.pop_back(); return 0; });
+    prefix.pop_back();
+    expect(algorithms::find_dip(prefix) - prefix.begin() ==
+           index.find_dip() - index.values().begin(), "dip_index::pop_back", prefix.size());
+  }
+  for (int value : values) {
+    timed("dip_index (push_back)", [&] { index.push_back(value); return 0; });
+  }
+  expect(expected - values.begin() == index.find_dip() - index.values().begin(),
+         "dip_index::push_back", values.size());
+}
+
+void check_longest_balanced_span(const std::vector<int>& values) {
+  auto expected = timed("longest_balanced_span",
+                        [&] { return algorithms::longest_balanced_span(values); });
+  expect(!expected || std::accumulate(expected->begin(), expected->end(), 0) == 0,
+         "longest_balanced_span (zero sum)", values.size());
+}
+
+void check_telegraph_style(const std::string& s) {
+  auto expected = timed("telegraph_style", [&] { return algorithms::telegraph_style(s); });
+  expect(expected.size() >= 5 && expected.compare(expected.size() - 5, 5, "STOP.") == 0,
+         "telegraph_style (STOP. suffix)", s.size());
+  expect(expected == timed("telegraph_style_parallel",
+                           [&] { return algorithms::telegraph_style_parallel(s); }),
+         "telegraph_style_parallel", s.size());
+  // force seams into short inputs too
+  expect(expected == timed("telegraph_chunks (tiny chunks)", [&] {
+           return algorithms::telegraph_chunks(s, 4, 1).str();
+         }), "telegraph_chunks", s.size());
+}
+
+// Decode bytes into the inputs of every check. The first byte picks how
+// values are decoded: a tiny alphabet, so that dips and balanced spans are
+// common, or the full range of a signed byte.
+void check_bytes(const uint8_t* data, size_t size) {
+  if (size == 0) {
+    return;
+  }
+  const bool tiny = data[0] & 1;
+  std::vector<int> values;
+  std::string text;
+  for (size_t i = 1; i < size; ++i) {
+    values.push_back(tiny ? int(data[i] % 5) - 2 : int(int8_t(data[i])));
+    text.push_back(char(data[i] & 0x7f));
+  }
+  check_find_dip(values);
+  check_longest_balanced_span(values);
+  check_telegraph_style(text);
+}
+
+#ifdef USE_LIBFUZZER
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+  check_bytes(data, size);
+  return 0;
+}
+
+#else
+
+int main(int argc, char* argv[]) {
+
+  const unsigned iterations = (argc > 1) ? std::atoi(argv[1]) : 2000;
+  std::mt19937 rng((argc > 2) ? std::atoi(argv[2]) : 0);
+
+  std::uniform_int_distribution<> random_size(0, 64), random_byte(0, 255);
+  for (unsigned i = 0; i < iterations; ++i) {
+    std::vector<uint8_t> bytes(random_size(rng));
+    for (auto& byte : bytes) {
+      byte = random_byte(rng);
+    }
+    check_bytes(bytes.data(), bytes.size());
+  }
+
+  for (size_t n : {0, 1, 2, 3, 10, 100, 1000}) {
+    for (const auto& workload : workloads::int_workloads()) {
+      auto values = workload.generate(n, rng);
+      check_find_dip(values);
+      check_longest_balanced_span(values);
+    }
+    for (const auto& workload : workloads::string_workloads()) {
+      check_telegraph_style(workload.generate(n, rng));
+    }
+  }
+
+  std::cout << "all engines agree" << std::endl;
+  for (const auto& [engine, seconds] : engine_seconds) {
+    std::cout << engine << ": " << seconds << " seconds" << std::endl;
+  }
+  return 0;
+}
+
+#endif
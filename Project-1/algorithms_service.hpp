@@ -0,0 +1,80 @@
+///////////////////////////////////////////////////////////////////////////////
+// algorithms_service.hpp
+//
+// The operations algorithms_server offers over service.hpp, and their
+// payload layouts. Integers are in native byte order.
+//
+// find_dip
+//   request:  int32 values[]
+//   response: int64 index of the last dip, or -1 when there is none
+//
+// longest_balanced_span
+//   request:  int32 values[], at most longest_balanced_span_limit of them
+//   response: uint8 found, then when found uint64 begin, uint64 end
+//
+// telegraph_style
+//   request:  the characters of the input
+//   response: the characters of the output
+//
+// Responses refer to the request by position instead of echoing its
+// values back. Requests outside these bounds get status_bad_request; the
+// limit keeps one request to the quadratic operation from occupying a pool
+// thread indefinitely.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "algorithms.hpp"
+#include "service.hpp"
+
+namespace algorithms_service {
+
+constexpr uint16_t find_dip = 1,
+                   longest_balanced_span = 2,
+                   telegraph_style = 3;
+
+// Most input elements accepted by longest_balanced_span.
+constexpr size_t longest_balanced_span_limit = 1 << 14;
+
+// Register every operation above with server.
+inline void register_operations(service::Server& server) {
+  server.handle(find_dip, "find_dip", [](service::PayloadReader& in, service::PayloadWriter& out) {
+    std::vector<int> values;
+    if (!in.read_rest(values)) {
+      return service::status_bad_request;
+    }
+    auto dip = algorithms::find_dip_vector(values);
+    out.write(int64_t((dip == values.end()) ? -1 : (dip - values.begin())));
+    return service::status_ok;
+  });
+
+  server.handle(longest_balanced_span, "longest_balanced_span",
+                [](service::PayloadReader& in, service::PayloadWriter& out) {
+    std::vector<int> values;
+    if (!in.read_rest(values) || values.size() > longest_balanced_span_limit) {
+      return service::status_bad_request;
+    }
+    auto best = algorithms::longest_balanced_span(values);
+    out.write(uint8_t(best.has_value()));
+    if (best) {
+      algorithms::offset_span64 offsets(*best, values);
+      out.write(offsets.begin());
+      out.write(offsets.end());
+    }
+    return service::status_ok;
+  });
+
+  server.handle(telegraph_style, "telegraph_style",
+                [](service::PayloadReader& in, service::PayloadWriter& out) {
+    out.bytes() = algorithms::telegraph_style(std::string(in.rest()));
+    return service::status_ok;
+  });
+}
+
+}
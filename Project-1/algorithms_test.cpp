@@ -5,12 +5,19 @@
 // Unit tests for the functionality declared in algorithms.hpp .
 ///////////////////////////////////////////////////////////////////////////////
 
+#include <array>
+#include <cstring>
+#include <map>
 #include <random>
+#include <string>
 #include <vector>
 
+#include <unistd.h>
+
 #include "gtest/gtest.h"
 
 #include "algorithms.hpp"
+#include "algorithms_service.hpp"
 
 template <typename T>
 std::vector<T> random_vector(size_t size, T min, T max) {
@@ -222,6 +229,17 @@ TEST(longest_balanced_span_nontrivial_cases, nontrivial_cases) {
     auto got = algorithms::longest_balanced_span(big);
     EXPECT_TRUE(got);
   }
+
+  { // the last span of each row ends at the back, which is never read past
+    std::vector<int> three{1, -1, 2};
+    auto got = algorithms::longest_balanced_span(three);
+    ASSERT_TRUE(got);
+    EXPECT_EQ(algorithms::span(three.begin(), three.begin() + 2), *got);
+    std::vector<int> back{2, 1, -1};
+    got = algorithms::longest_balanced_span(back);
+    ASSERT_TRUE(got);
+    EXPECT_EQ(algorithms::span(back.begin() + 1, back.end()), *got);
+  }
 }
 
 TEST(telegraph_style_trivial_cases, trivial_cases) {
@@ -276,6 +294,12 @@ TEST(telegraph_style_nontrivial_cases, nontrivial_cases) {
   EXPECT_EQ("A BSTOP.", algorithms::telegraph_style("A    B")); // at back
   EXPECT_EQ(" A B STOP.", algorithms::telegraph_style("    A    B    ")); // all three
 
+  // a space while the output is still empty, including after removed
+  // characters, is kept once
+  EXPECT_EQ(" STOP.", algorithms::telegraph_style("  "));
+  EXPECT_EQ(" ASTOP.", algorithms::telegraph_style("#$ A"));
+  EXPECT_EQ(" STOP.", algorithms::telegraph_style("\t\n   "));
+
   // lower-case stop counts
   EXPECT_EQ("STOP.", algorithms::telegraph_style("stop."));
 
@@ -298,3 +322,255 @@ TEST(telegraph_style_nontrivial_cases, nontrivial_cases) {
     algorithms::telegraph_style(big);
   }
 }
+
+TEST(find_dip_fixed_size, fixed_size) {
+  { // usable in constant expressions
+    constexpr std::array<int, 2> two{8, 2};
+    static_assert(algorithms::find_dip(two) == two.end());
+    constexpr std::array<int, 12> vec{5, 4, 5, 10, 8, 7, 8, 10, 9, 8, 9, 10};
+    static_assert(algorithms::find_dip(vec) == vec.begin() + 8);
+  }
+
+  { // dispatcher agrees with find_dip at every routed size
+    for (size_t n = 0; n <= algorithms::find_dip_fixed_limit + 2; ++n) {
+      auto values = random_vector<int>(n, 0, 2);
+      EXPECT_EQ(algorithms::find_dip(values), algorithms::find_dip_auto(values));
+    }
+  }
+}
+
+TEST(offset_span, offset_span) {
+  std::vector<int> values{3, 1, 5, -8, 2, 1, 4};
+  auto best = algorithms::longest_balanced_span(values);
+  ASSERT_TRUE(best.has_value());
+  algorithms::offset_span32 compact(*best, values);
+  EXPECT_EQ(2, compact.begin());
+  EXPECT_EQ(6, compact.end());
+  EXPECT_EQ(4, compact.size());
+  EXPECT_EQ(*best, compact.to_span(values));
+
+  // the offsets stay valid for a copy of the vector
+  std::vector<int> copy(values);
+  EXPECT_EQ(copy.begin() + 2, compact.to_span(copy).begin());
+}
+
+TEST(dip_index, dip_index) {
+  { // queries on a fixed input
+    algorithms::dip_index index({5, 4, 5, 10, 8, 7, 8, 10, 9, 8, 9, 10});
+    EXPECT_EQ(3, index.count());
+    EXPECT_EQ(8, index.last_dip());
+    EXPECT_EQ(4, index.last_dip_in(0, 8));
+    EXPECT_EQ(0, index.last_dip_in(0, 6));
+    EXPECT_FALSE(index.last_dip_in(1, 6).has_value());
+    EXPECT_EQ(index.values().begin() + 8, index.find_dip());
+    EXPECT_EQ(index.values().end(), index.to_iterator(std::nullopt));
+  }
+
+  { // agrees with find_dip after every update, append, and removal,
+    // spanning several summary levels
+    std::minstd_rand rng(0);
+    std::uniform_int_distribution<int> value(0, 2);
+    algorithms::dip_index index;
+    auto check = [&] {
+      const auto& values = index.values();
+      ASSERT_EQ(algorithms::find_dip(values) - values.begin(),
+                index.find_dip() - values.begin());
+    };
+    for (size_t i = 0; i < 5000; ++i) {
+      index.push_back(value(rng));
+      check();
+    }
+    for (size_t i = 0; i < 2000; ++i) {
+      index.set(rng() % index.size(), value(rng));
+      check();
+    }
+    size_t count = 0;
+    for (size_t i = 0; i + 2 < index.size(); ++i) {
+      count += index.is_dip(i);
+    }
+    EXPECT_EQ(count, index.count());
+    while (index.size() > 0) {
+      index.pop_back();
+      check();
+    }
+    EXPECT_EQ(0, index.count());
+  }
+}
+
+TEST(telegraph_style_parallel, telegraph_style_parallel) {
+  { // seams between one-character chunks land everywhere
+    for (std::string s : {"", " ", "    ", "stop", "STOP.", "ab  STOP;", "  a   b  ",
+                          "A B STO  P.", "x STOP!", "  STOP.  ", "ST^$__OP."}) {
+      for (unsigned threads : {1, 2, 3, 7, 64}) {
+        algorithms::telegraph_chunks chunks(s, threads, 1);
+        std::string joined;
+        for (size_t i = 0; i < chunks.pieces(); ++i) {
+          EXPECT_EQ(joined.size(), chunks.offset(i));
+          joined += chunks.piece(i);
+        }
+        EXPECT_EQ(algorithms::telegraph_style(s), joined);
+        EXPECT_EQ(joined, chunks.str());
+      }
+    }
+  }
+
+  { // 10MB string
+    auto vect = random_vector<char>(10*1000*1000, ' ', '~');
+    std::string big(vect.begin(), vect.end());
+    EXPECT_EQ(algorithms::telegraph_style(big), algorithms::telegraph_style_parallel(big, 8));
+  }
+}
+
+TEST(find_dip_vector, every_supported_level) {
+  for (auto level : cpu_dispatch::supported_levels()) {
+    cpu_dispatch::ScopedLevel scope(level);
+    // every size around the block widths, with dips in every position
+    for (size_t n = 0; n <= 40; ++n) {
+      auto values = random_vector<int>(n, 0, 2);
+      EXPECT_EQ(algorithms::find_dip(values), algorithms::find_dip_vector(values))
+        << cpu_dispatch::name(level) << ", n=" << n;
+    }
+    std::vector<int> none(1000, 7);
+    EXPECT_EQ(none.end(), algorithms::find_dip_vector(none));
+    none[0] = none[2] = 9;
+    EXPECT_EQ(none.begin(), algorithms::find_dip_vector(none));
+  }
+}
+
+TEST(algorithms_service, algorithms_service) {
+  const std::string path = "/tmp/algorithms_test." + std::to_string(getpid()) + ".sock";
+  service::Server server(path, 2);
+  algorithms_service::register_operations(server);
+  server.start();
+  service::Client client(path);
+
+  std::vector<int> values{3, 1, 5, -8, 2, 1, 4, 2, 4};
+  const std::string request(reinterpret_cast<const char*>(values.data()),
+                            values.size() * sizeof(int));
+
+  { // find_dip
+    auto [status, response] = client.call(algorithms_service::find_dip, request);
+    ASSERT_EQ(service::status_ok, status);
+    ASSERT_EQ(sizeof(int64_t), response.size());
+    int64_t index;
+    std::memcpy(&index, response.data(), sizeof(index));
+    EXPECT_EQ(algorithms::find_dip(values) - values.begin(), index);
+  }
+
+  { // longest_balanced_span
+    auto [status, response] = client.call(algorithms_service::longest_balanced_span, request);
+    ASSERT_EQ(service::status_ok, status);
+    service::PayloadReader in(response);
+    uint8_t found;
+    uint64_t begin, end;
+    ASSERT_TRUE(in.read(found) && found && in.read(begin) && in.read(end));
+    auto expected = algorithms::longest_balanced_span(values);
+    EXPECT_EQ(expected->begin() - values.begin(), begin);
+    EXPECT_EQ(expected->end() - values.begin(), end);
+  }
+
+  { // pipelined requests all get their own responses
+    std::map<uint64_t, std::string> inputs;
+    for (std::string s : {"hello world", "  a  b  ", "", "stop!"}) {
+      inputs[client.send(algorithms_service::telegraph_style, s)] = s;
+    }
+    for (size_t i = 0; i < 4; ++i) {
+      auto [id, status, response] = client.receive();
+      ASSERT_EQ(service::status_ok, status);
+      EXPECT_EQ(algorithms::telegraph_style(inputs.at(id)), response);
+    }
+  }
+
+  { // malformed, oversized and unknown requests
+    EXPECT_EQ(service::status_bad_request,
+              client.call(algorithms_service::find_dip, "abc").first);
+    std::vector<int> long_values(algorithms_service::longest_balanced_span_limit + 1, 1);
+    EXPECT_EQ(service::status_bad_request,
+              client.call(algorithms_service::longest_balanced_span,
+                          std::string(reinterpret_cast<const char*>(long_values.data()),
+                                      long_values.size() * sizeof(int))).first);
+    EXPECT_EQ(service::status_unknown_operation, client.call(999, "").first);
+  }
+
+  { // stats report every operation
+    auto [status, report] = client.call(service::stats_operation, "");
+    ASSERT_EQ(service::status_ok, status);
+    EXPECT_NE(std::string::npos, report.find("find_dip: count=2"));
+    EXPECT_NE(std::string::npos, report.find("telegraph_style: count=4"));
+  }
+
+  server.stop();
+}
+
+TEST(longest_balanced_span_memo, result_cache) {
+  { // repeated contents hit, even in a different vector
+    algorithms::balanced_span_cache cache(2);
+    std::vector<int> values{3, 1, 5, -8, 2, 1, 4}, copy(values), none{1, 2, 3};
+    EXPECT_EQ(algorithms::longest_balanced_span(values),
+              algorithms::longest_balanced_span_memo(values, cache));
+    auto again = algorithms::longest_balanced_span_memo(copy, cache);
+    ASSERT_TRUE(again.has_value());
+    EXPECT_EQ(copy.begin() + 2, again->begin());
+    EXPECT_FALSE(algorithms::longest_balanced_span_memo(none, cache).has_value());
+    EXPECT_FALSE(algorithms::longest_balanced_span_memo(none, cache).has_value());
+    auto stats = cache.stats();
+    EXPECT_EQ(2, stats.memory_hits);
+    EXPECT_EQ(2, stats.misses);
+    EXPECT_DOUBLE_EQ(0.5, stats.hit_rate());
+
+    // a third distinct input evicts the least recently used
+    std::vector<int> third{0};
+    algorithms::longest_balanced_span_memo(third, cache);
+    EXPECT_EQ(1, cache.stats().evictions);
+    algorithms::longest_balanced_span_memo(values, cache);
+    EXPECT_EQ(4, cache.stats().misses);
+  }
+
+  { // the disk tier outlives the cache object
+    const std::string path = "/tmp/algorithms_test." + std::to_string(getpid()) + ".cache";
+    std::vector<int> values{5, -5, 7};
+    {
+      algorithms::balanced_span_cache cache(10, path, 64);
+      ASSERT_TRUE(cache.has_disk_tier());
+      algorithms::longest_balanced_span_memo(values, cache);
+    }
+    algorithms::balanced_span_cache cache(10, path, 64);
+    auto cached = algorithms::longest_balanced_span_memo(values, cache);
+    EXPECT_EQ(algorithms::longest_balanced_span(values), cached);
+    EXPECT_EQ(1, cache.stats().disk_hits);
+    unlink(path.c_str());
+  }
+
+  { // keys depend on every piece and on how the pieces are split
+    using result_cache::KeyHasher;
+    std::vector<int> a{1, 2}, b{1}, c{2};
+    EXPECT_NE(KeyHasher("f").add_array(a).key(), KeyHasher("g").add_array(a).key());
+    EXPECT_NE(KeyHasher("f").add_array(a).key(),
+              KeyHasher("f").add_array(b).add_array(c).key());
+    EXPECT_EQ(KeyHasher("f").add_array(a).add(7).key(), KeyHasher("f").add_array(a).add(7).key());
+  }
+}
+
+TEST(find_dip_parallel, huge_buffer) {
+  { // dips on either side of every partition boundary
+    for (size_t n = 0; n <= 40; ++n) {
+      auto values = random_vector<int>(n, 0, 2);
+      for (unsigned threads = 1; threads <= 5; ++threads) {
+        EXPECT_EQ(algorithms::find_dip(values), algorithms::find_dip_parallel(values, threads))
+          << "n=" << n << ", threads=" << threads;
+      }
+    }
+  }
+
+  { // huge-page buffer initialized by first touch
+    const size_t n = 3 * 1000 * 1000;
+    HugeBuffer<int> buffer(n, 4, [](size_t i) { return int(i % 1000); });
+    ASSERT_EQ(n, buffer.size());
+    EXPECT_EQ(0, reinterpret_cast<uintptr_t>(buffer.data()) % HugeBuffer<int>::huge_page_bytes);
+    EXPECT_EQ(999, buffer[n - 1]);
+    EXPECT_EQ(n, algorithms::find_dip_parallel(buffer.data(), n, 4));
+    buffer[1234565] = buffer[1234567] = 7;
+    buffer[1234566] = 6;
+    EXPECT_EQ(1234565, algorithms::find_dip_parallel(buffer.data(), n, 4));
+  }
+}
@@ -5,6 +5,11 @@
 // elapsed times precisely. You should modify this program to gather
 // all of your experimental data.
 //
+// Usage: algorithms_timing [--large]
+//
+// --large adds scans of 100 million elements, which allocate two inputs of
+// 400 MB each.
+//
 ///////////////////////////////////////////////////////////////////////////////
 
 #include <algorithm>
@@ -12,9 +17,13 @@
 #include <iostream>
 #include <random>
 #include <string>
+#include <thread>
 #include <vector>
 
+#include "alloc_tracker.hpp"
+#include "huge_buffer.hpp"
 #include "timer.hpp"
+#include "workloads.hpp"
 
 #include "algorithms.hpp"
 
@@ -22,7 +31,28 @@ void print_bar() {
   std::cout << std::string(79, '-') << std::endl;
 }
 
-int main() {
+// Time algorithm on an input of size n from every workload in list, printing
+// one line per workload.
+template <typename T, typename Algorithm>
+void sweep(const std::string& title, const std::vector<workloads::Workload<T>>& list,
+           size_t n, Algorithm algorithm) {
+  print_bar();
+  std::cout << title << ", all workloads" << std::endl;
+  std::mt19937 rng(0);
+  for (const auto& workload : list) {
+    T input = workload.generate(n, rng);
+    AllocScope scope;
+    Timer timer;
+    algorithm(input);
+    double elapsed = timer.elapsed();
+    std::cout << workload.name << ": elapsed time=" << elapsed << " seconds, "
+              << scope.stats() << std::endl;
+  }
+}
+
+int main(int argc, char* argv[]) {
+
+  const bool large = (argc > 1) && (std::string(argv[1]) == "--large");
 
   const size_t n = 2*1000; // 2,000
 
@@ -44,36 +74,119 @@ int main() {
 
   Timer timer;
   double elapsed;
+  AllocStats allocs;
 
   print_bar();
   std::cout << "n = " << n << std::endl;
+  std::cout << "active instruction set: " << cpu_dispatch::name(cpu_dispatch::active())
+            << std::endl;
 
   print_bar();
   std::cout << "find dip" << std::endl;
   {
+    AllocScope scope;
     timer.reset();
     algorithms::find_dip(vec);
     elapsed = timer.elapsed();
+    allocs = scope.stats();
   }
-  std::cout << "elapsed time=" << elapsed << " seconds" << std::endl;
+  std::cout << "elapsed time=" << elapsed << " seconds" << std::endl
+            << allocs << std::endl;
 
   print_bar();
   std::cout << "longest balanced span" << std::endl;
   {
+    AllocScope scope;
     timer.reset();
     algorithms::longest_balanced_span(vec);
     elapsed = timer.elapsed();
+    allocs = scope.stats();
+  }
+  std::cout << "elapsed time=" << elapsed << " seconds" << std::endl
+            << allocs << std::endl;
+
+  print_bar();
+  std::cout << "longest balanced span, memoized, repeated 10 times" << std::endl;
+  {
+    algorithms::balanced_span_cache cache(100);
+    for (size_t i = 0; i < 10; ++i) {
+      AllocScope scope;
+      timer.reset();
+      algorithms::longest_balanced_span_memo(vec, cache);
+      elapsed = timer.elapsed();
+      allocs = scope.stats();
+      std::cout << "elapsed time=" << elapsed << " seconds, " << allocs << std::endl;
+    }
+    std::cout << cache.stats() << std::endl;
   }
-  std::cout << "elapsed time=" << elapsed << " seconds" << std::endl;
 
   print_bar();
   std::cout << "telegraph_style" << std::endl;
   {
+    AllocScope scope;
     timer.reset();
     algorithms::telegraph_style(str);
     elapsed = timer.elapsed();
+    allocs = scope.stats();
+  }
+  std::cout << "elapsed time=" << elapsed << " seconds" << std::endl
+            << allocs << std::endl;
+
+  // Scans at large n, of an ordinary vector built with push_back and of a
+  // huge-page buffer placed by first touch. The input has no dips, so every
+  // scan reads all of it.
+  if (large) {
+    const size_t large_n = 100*1000*1000;
+    const unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    auto value = [](size_t i) { return int(i % 1000); };
+
+    print_bar();
+    std::cout << "find dip, n=" << large_n << ", " << threads << " threads" << std::endl;
+
+    timer.reset();
+    std::vector<int> ordinary;
+    for (size_t i = 0; i < large_n; ++i) {
+      ordinary.push_back(value(i));
+    }
+    std::cout << "std::vector built with push_back: " << timer.elapsed() << " seconds"
+              << std::endl;
+    timer.reset();
+    algorithms::find_dip(ordinary);
+    std::cout << "find_dip: elapsed time=" << timer.elapsed() << " seconds" << std::endl;
+    timer.reset();
+    algorithms::find_dip_parallel(ordinary, threads);
+    std::cout << "find_dip_parallel: elapsed time=" << timer.elapsed() << " seconds"
+              << std::endl;
+
+    timer.reset();
+    HugeBuffer<int> huge(large_n, threads, value);
+    std::cout << "HugeBuffer built by first touch: " << timer.elapsed() << " seconds, "
+              << (huge.explicit_huge_pages() ? "explicit" : "transparent") << " huge pages"
+              << std::endl;
+    timer.reset();
+    algorithms::find_dip_parallel(huge.data(), huge.size(), threads);
+    std::cout << "find_dip_parallel on HugeBuffer: elapsed time=" << timer.elapsed()
+              << " seconds" << std::endl;
+  }
+
+  sweep("find dip", workloads::int_workloads(), n,
+        [](const std::vector<int>& input) { algorithms::find_dip(input); });
+  for (auto level : cpu_dispatch::supported_levels()) {
+    cpu_dispatch::ScopedLevel scope(level);
+    sweep(std::string("find dip, vectorized for ") + cpu_dispatch::name(level) + ", n=10,000,000",
+          workloads::int_workloads(), 10*1000*1000,
+          [](const std::vector<int>& input) { algorithms::find_dip_vector(input); });
   }
-  std::cout << "elapsed time=" << elapsed << " seconds" << std::endl;
+  sweep("find dip, n=10,000,000", workloads::int_workloads(), 10*1000*1000,
+        [](const std::vector<int>& input) { algorithms::find_dip(input); });
+  sweep("longest balanced span", workloads::int_workloads(), n,
+        [](const std::vector<int>& input) { algorithms::longest_balanced_span(input); });
+  sweep("telegraph_style", workloads::string_workloads(), n,
+        [](const std::string& input) { algorithms::telegraph_style(input); });
+  sweep("telegraph_style, 10,000,000 characters", workloads::string_workloads(), 10*1000*1000,
+        [](const std::string& input) { algorithms::telegraph_style(input); });
+  sweep("telegraph_style_parallel, 10,000,000 characters", workloads::string_workloads(), 10*1000*1000,
+        [](const std::string& input) { algorithms::telegraph_style_parallel(input); });
 
   print_bar();
 
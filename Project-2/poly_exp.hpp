@@ -3,17 +3,44 @@
 // poly_exp.hpp
 //
 // Definitions for two algorithms that solve the Maximum Subarray Problem,
-// and one algorithm that solves the Subset Sum Problem.
+// and one algorithm that solves the Subset Sum Problem, followed by faster
+// and more specialized engines for both problems.
 //
 ///////////////////////////////////////////////////////////////////////////////
 
 #pragma once
 
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
 #include <functional>
+#include <limits>
+#include <mutex>
+#include <numeric>
 #include <optional>
+#include <ostream>
+#include <queue>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
+#include "cpu_dispatch.hpp"
+#include "fixed_size.hpp"
+#include "huge_buffer.hpp"
+#include "result_cache.hpp"
+
 namespace subarray {
 
 // A summed_span represents a non-empty range of indices inside of a vector of
@@ -66,6 +93,95 @@ public:
   }
 };
 
+// A compact alternative to summed_span, storing the range as unsigned offsets
+// into the input vector instead of iterators. With a 32-bit Offset the whole
+// span is 12 bytes. It is trivially copyable and not tied to any particular
+// vector object, so spans can be stored densely in flat arrays, written to
+// files or shared memory as raw bytes, and read back without pointer fixups.
+// Offset must be an unsigned integer type, normally uint32_t or uint64_t. Sum
+// is int, like summed_span, or a wider signed type for sums over inputs too
+// long for an int.
+//
+// The default constructor makes an empty placeholder, so that arrays of spans
+// can be allocated before they are filled in. Every other span is non-empty.
+template <typename Offset, typename Sum = int>
+class offset_summed_span {
+  static_assert(std::is_unsigned_v<Offset>, "Offset must be unsigned");
+  static_assert(std::is_signed_v<Sum>, "Sum must be signed");
+
+private:
+  Offset begin_, end_;
+  Sum sum_;
+
+public:
+
+  constexpr offset_summed_span() : begin_(0), end_(0), sum_(0) {}
+
+  // Constructor, given the begin offset, end offset, and sum of elements in
+  // the range. begin must come before end.
+  constexpr offset_summed_span(Offset begin, Offset end, Sum sum)
+  : begin_(begin), end_(end), sum_(sum) {
+    assert(begin < end);
+  }
+
+  // Convert from a summed_span with iterators into input.
+  offset_summed_span(const summed_span& span, const std::vector<int>& input)
+  : offset_summed_span(Offset(span.begin() - input.begin()),
+                       Offset(span.end() - input.begin()), span.sum()) {
+    assert(size_t(span.end() - input.begin()) <= std::numeric_limits<Offset>::max());
+  }
+
+  // Convert to a summed_span with iterators into input, which must be the
+  // vector the offsets refer to. The sum must fit in an int.
+  summed_span to_summed_span(const std::vector<int>& input) const {
+    assert(end_ <= input.size());
+    assert(sum_ >= std::numeric_limits<int>::min() && sum_ <= std::numeric_limits<int>::max());
+    return summed_span(input.begin() + begin_, input.begin() + end_, int(sum_));
+  }
+
+  // Equality tests, two spans are equal when each of their offsets are equal.
+  constexpr bool operator== (const offset_summed_span& rhs) const {
+    return (begin_ == rhs.begin_) && (end_ == rhs.end_);
+  }
+
+  // Accessors.
+  constexpr Offset begin() const { return begin_; }
+  constexpr Offset end  () const { return end_  ; }
+  constexpr Sum sum() const { return sum_; }
+
+  // Compute the number of elements in the span.
+  constexpr size_t size() const { return end_ - begin_; }
+
+  // Stream insertion operator, so this class is printable.
+  friend std::ostream& operator<<(std::ostream& stream, const offset_summed_span& rhs) {
+    stream << "offset_summed_span, begin=" << rhs.begin() << ", end=" << rhs.end()
+           << ", sum=" << rhs.sum();
+    return stream;
+  }
+};
+
+using offset_summed_span32 = offset_summed_span<uint32_t>;
+using offset_summed_span64 = offset_summed_span<uint64_t>;
+using wide_offset_summed_span = offset_summed_span<uint64_t, int64_t>;
+
+static_assert(sizeof(offset_summed_span32) == 12);
+static_assert(std::is_trivially_copyable_v<offset_summed_span32>);
+static_assert(std::is_trivially_copyable_v<offset_summed_span64>);
+static_assert(std::is_trivially_copyable_v<wide_offset_summed_span>);
+
+// Convert spans with iterators into input, such as the results of
+// max_subarrays_top_k, into a dense array of offset spans.
+template <typename Offset = uint32_t>
+std::vector<offset_summed_span<Offset>> to_offset_spans(const std::vector<summed_span>& spans,
+                                                        const std::vector<int>& input) {
+  std::vector<offset_summed_span<Offset>> result;
+  result.reserve(spans.size());
+  for (const summed_span& span : spans) {
+    result.emplace_back(span, input);
+  }
+  return result;
+}
+
 // Compute the maximum subarray of input; i.e. the non-empty contiguous span of
 // elements with the maximum sum. input must be nonempty. This function uses an
 // exhaustive search algorithm that takes O(n^3) time.
@@ -86,87 +202,2158 @@ summed_span max_subarray_exh(const std::vector<int>& input) {
   }
   return summed_span(input.begin() + b , input.begin() + e);
 }
-summed_span maximum_subarray_crossing(const std::vector<int>& vec, int clow, int cmiddle, int chigh){
-  int left_sum =-999;
-  int right_sum = -999;
-  int sum = 0;
-  int b =0;
-  int e = 0;
-  for(int i = cmiddle ; i >= clow; i--){
-    sum += vec[i];
-    if (sum > left_sum){
+
+// Tie rules for basic_span_summary.
+enum class span_ties {
+  // The maximum-sum span with the lowest begin, and among those the lowest
+  // end; the order max_subarray_exh uses. Merging is associative, so
+  // summaries can be merged in any grouping.
+  lowest_first,
+  // The order of max_subarray_dbh: the best span of the left half, then that
+  // of the right half, then the crossing span, which extends no further into
+  // either half than it must. Merging is not associative, so summaries must
+  // be merged along max_subarray_dbh's midpoint splits.
+  halving,
+};
+
+// Summary of a non-empty range of elements, used to merge maximum subarray
+// answers for adjacent ranges in O(1) time. Indices are absolute positions in
+// the input; ends are exclusive. Merging the summaries of two adjacent
+// ranges gives the summary of their union, breaking ties by Ties.
+template <span_ties Ties>
+struct basic_span_summary {
+  int64_t total;
+  int64_t prefix;  size_t prefix_end;
+  int64_t suffix;  size_t suffix_begin;
+  int64_t best;    size_t best_begin, best_end;
+
+  static constexpr basic_span_summary leaf(size_t index, int value) {
+    return {value, value, index + 1, value, index, value, index, index + 1};
+  }
+
+  static constexpr basic_span_summary merge(const basic_span_summary& left,
+                                            const basic_span_summary& right) {
+    basic_span_summary result{left.total + right.total,
+                              left.prefix, left.prefix_end,
+                              right.suffix, right.suffix_begin,
+                              left.best, left.best_begin, left.best_end};
+
+    // Prefer the shorter prefix on ties.
+    if (left.total + right.prefix > left.prefix) {
+      result.prefix = left.total + right.prefix;
+      result.prefix_end = right.prefix_end;
+    }
+
+    // lowest_first prefers the longer suffix on ties, so that best begins as
+    // early as possible; halving prefers the shorter one.
+    const int64_t extended = left.suffix + right.total;
+    if (Ties == span_ties::lowest_first ? extended >= right.suffix : extended > right.suffix) {
+      result.suffix = extended;
+      result.suffix_begin = left.suffix_begin;
+    }
+
+    const int64_t crossing = left.suffix + right.prefix;
+    if constexpr (Ties == span_ties::lowest_first) {
+      // Candidates in increasing order of begin, then end: left, crossing,
+      // right. Only a strictly larger sum displaces an earlier candidate.
+      if (crossing > result.best) {
+        result.best = crossing;
+        result.best_begin = left.suffix_begin;
+        result.best_end = right.prefix_end;
+      }
+      if (right.best > result.best) {
+        result.best = right.best;
+        result.best_begin = right.best_begin;
+        result.best_end = right.best_end;
+      }
+    } else {
+      // Left, then right, then crossing.
+      if (left.best < right.best || left.best < crossing) {
+        if (right.best >= crossing) {
+          result.best = right.best;
+          result.best_begin = right.best_begin;
+          result.best_end = right.best_end;
+        } else {
+          result.best = crossing;
+          result.best_begin = left.suffix_begin;
+          result.best_end = right.prefix_end;
+        }
+      }
+    }
+    return result;
+  }
+};
+
+using span_summary = basic_span_summary<span_ties::lowest_first>;
+using halving_summary = basic_span_summary<span_ties::halving>;
+
+// The decrease-by-half recursion over values[Low, High], expanded at compile
+// time into a fixed network of summary merges with no calls or loops left at
+// run time.
+template <size_t Low, size_t High>
+constexpr halving_summary max_subarray_network(const int* values) {
+  if constexpr (Low == High) {
+    return halving_summary::leaf(Low, values[Low]);
+  } else {
+    constexpr size_t middle = (Low + High) / 2;
+    return halving_summary::merge(max_subarray_network<Low, middle>(values),
+                                  max_subarray_network<middle + 1, High>(values));
+  }
+}
+
+// Compute the maximum subarray of a fixed-size array with the same splits and
+// tie-breaking as max_subarray_dbh, fully unrolled at compile time. Usable in
+// constexpr contexts. N must be at least 1.
+template <size_t N>
+constexpr offset_summed_span32 max_subarray_dbh(const std::array<int, N>& input) {
+  static_assert(N > 0, "input must be nonempty");
+  halving_summary summary = max_subarray_network<0, N - 1>(input.data());
+  return offset_summed_span32(summary.best_begin, summary.best_end, int(summary.best));
+}
+
+// Largest input routed to the unrolled max_subarray_dbh by
+// max_subarray_dbh_auto, and longest range max_subarray_dbh summarizes with
+// an unrolled network.
+constexpr size_t max_subarray_fixed_limit = 64;
+
+// One max_subarray_network per block length up to max_subarray_fixed_limit,
+// so that max_subarray_dbh can summarize short ranges without recursing.
+template <size_t N>
+halving_summary halving_block(const int* values) {
+  return max_subarray_network<0, N - 1>(values);
+}
+
+template <size_t... Lengths>
+constexpr std::array<halving_summary (*)(const int*), sizeof...(Lengths)>
+halving_blocks(std::index_sequence<Lengths...>) {
+  return {&halving_block<Lengths + 1>...};
+}
+
+// Summary of input[low, low + n), merged along the midpoint splits of
+// max_subarray_dbh. n must be positive.
+halving_summary max_subarray_halving(const int* input, size_t low, size_t n) {
+  if (n <= max_subarray_fixed_limit) {
+    static constexpr auto blocks =
+      halving_blocks(std::make_index_sequence<max_subarray_fixed_limit>());
+    halving_summary summary = blocks[n - 1](input + low);
+    summary.prefix_end += low;
+    summary.suffix_begin += low;
+    summary.best_begin += low;
+    summary.best_end += low;
+    return summary;
+  }
+  // the left half of [low, high] ends at middle = (low + high) / 2
+  const size_t left = (n + 1) / 2;
+  return halving_summary::merge(max_subarray_halving(input, low, left),
+                                max_subarray_halving(input, low + left, n - left));
+}
+
+// Compute the maximum subarray using a decrease-by-half algorithm that takes
+// O(n) time.
+//
+// The range [low, high] is split at middle = (low + high) / 2, and the
+// summaries of the two halves are merged, so the crossing span comes from the
+// halves' best suffix and prefix instead of a rescan of both halves. Where
+// the splits fall depends only on the length of a range, so a range of at
+// most max_subarray_fixed_limit elements is summarized by the unrolled
+// network for its length, which makes the same splits with no calls.
+summed_span max_subarray_dbh(const std::vector<int>& input) {
+
+  assert(!input.empty());
+
+  halving_summary whole = max_subarray_halving(input.data(), 0, input.size());
+  return summed_span(input.begin() + whole.best_begin, input.begin() + whole.best_end,
+                     int(whole.best));
+}
+
+// The best span of input[low, high], by the O(n log n) form of the
+// decrease-by-half algorithm, which rescans both halves of every range for
+// the crossing span.
+summed_span max_subarray_rescan(const std::vector<int>& input, size_t low, size_t high) {
+  if (low == high) {
+    return summed_span(input.begin() + low, input.begin() + low + 1);
+  }
+  const size_t middle = (low + high) / 2;
+  summed_span left = max_subarray_rescan(input, low, middle),
+              right = max_subarray_rescan(input, middle + 1, high);
+
+  // The crossing span extends no further into either half than it must.
+  int64_t sum = 0, left_sum = std::numeric_limits<int64_t>::min();
+  size_t begin = middle;
+  for (size_t i = middle + 1; i-- > low; ) {
+    sum += input[i];
+    if (sum > left_sum) {
       left_sum = sum;
-      b = i;
+      begin = i;
     }
   }
   sum = 0;
-  for(int i = cmiddle + 1; i <= chigh; i++){
-    sum += vec[i];
-    if(sum > right_sum){
+  int64_t right_sum = std::numeric_limits<int64_t>::min();
+  size_t end = middle + 2;
+  for (size_t i = middle + 1; i <= high; ++i) {
+    sum += input[i];
+    if (sum > right_sum) {
       right_sum = sum;
-      e = i;
+      end = i + 1;
     }
   }
-  return summed_span(vec.begin() + b, vec.begin() + (e + 1));
+  summed_span crossing(input.begin() + begin, input.begin() + end, int(left_sum + right_sum));
+
+  if (left.sum() >= right.sum() && left.sum() >= crossing.sum()) {
+    return left;
+  }
+  if (right.sum() >= crossing.sum()) {
+    return right;
+  }
+  return crossing;
+}
+
+// Compute the same result as max_subarray_dbh in O(n log n) time, the way
+// max_subarray_dbh did before it merged summaries. The reference for
+// max_subarray_dbh's tie-breaking, and the baseline it is timed against.
+summed_span max_subarray_dbh_rescan(const std::vector<int>& input) {
+
+  assert(!input.empty());
+
+  return max_subarray_rescan(input, 0, input.size() - 1);
+}
+
+// Compute the same result as max_subarray_dbh, routing inputs of at most
+// max_subarray_fixed_limit elements to the unrolled fixed-size network.
+summed_span max_subarray_dbh_auto(const std::vector<int>& input) {
+
+  assert(!input.empty());
+
+  if (input.size() > max_subarray_fixed_limit) {
+    return max_subarray_dbh(input);
+  }
+  return fixed_size::call<1, max_subarray_fixed_limit>(
+    input, [](const auto& values) { return max_subarray_dbh(values); }).to_summed_span(input);
 }
-summed_span maximum_subarray_recurse(const std::vector<int>& V, int low, int high){
-  if (low == high){
-    return summed_span(V.begin() + low, V.begin() + low + 1);
+
+// Prefix sums of input, with prefix[0] == 0 and prefix[i] equal to the sum of
+// the first i elements, so the sum of the range [b, e) is
+// prefix[e] - prefix[b]. Sums are 64-bit so that large inputs cannot overflow.
+std::vector<int64_t> prefix_sums(const std::vector<int>& input) {
+  std::vector<int64_t> prefix(input.size() + 1, 0);
+  for (size_t i = 0; i < input.size(); ++i) {
+    prefix[i + 1] = prefix[i] + input[i];
   }
-  int middle = (low + high) / 2;
-  summed_span entirely_left = maximum_subarray_recurse(V, low, middle); 
-  summed_span entirely_right = maximum_subarray_recurse(V, middle + 1, high);
-  summed_span crossing = maximum_subarray_crossing(V, low, middle, high);
-  if(entirely_left.sum() >= entirely_right.sum() && entirely_left.sum() >= crossing.sum()){
-    
-    return entirely_left;
+  return prefix;
+}
 
-  }else if (entirely_right.sum() >= entirely_left.sum() && entirely_right.sum() >= crossing.sum()){
-    
-    return entirely_right;
-  }else{
-    return crossing;
+// Instruction set variants of the search at the heart of
+// max_subarray_exh_quadratic. Each returns the index of the first maximum
+// in values[0, n), where n > 0. The vector variants find the maximum with
+// one lane per element, then find its first occurrence with a second pass
+// that stops at the first block containing it.
+namespace kernels {
+
+inline size_t first_max_scalar(const int64_t* values, size_t n) {
+  size_t best = 0;
+  for (size_t i = 1; i < n; ++i) {
+    if (values[i] > values[best]) {
+      best = i;
+    }
   }
+  return best;
 }
-// Compute the maximum subarray using a decrease-by-half algorithm that takes
-// O(n log n) time.
-summed_span max_subarray_dbh(const std::vector<int>& input) {
+
+#if CPU_DISPATCH_X86
+
+CPU_DISPATCH_TARGET_SSE42
+inline size_t first_max_sse42(const int64_t* values, size_t n) {
+  int64_t best = values[0];
+  size_t i = 0;
+  if (n >= 2) {
+    __m128i m = _mm_loadu_si128(reinterpret_cast<const __m128i*>(values));
+    for (i = 2; i + 2 <= n; i += 2) {
+      __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(values + i));
+      m = _mm_blendv_epi8(m, x, _mm_cmpgt_epi64(x, m));
+    }
+    int64_t lanes[2];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), m);
+    best = std::max(lanes[0], lanes[1]);
+  }
+  for (; i < n; ++i) {
+    best = std::max(best, values[i]);
+  }
+
+  const __m128i target = _mm_set1_epi64x(best);
+  for (i = 0; i + 2 <= n; i += 2) {
+    __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(values + i));
+    unsigned mask = _mm_movemask_pd(_mm_castsi128_pd(_mm_cmpeq_epi64(x, target)));
+    if (mask) {
+      return i + __builtin_ctz(mask);
+    }
+  }
+  for (; values[i] != best; ++i) {
+  }
+  return i;
+}
+
+CPU_DISPATCH_TARGET_AVX2
+inline size_t first_max_avx2(const int64_t* values, size_t n) {
+  int64_t best = values[0];
+  size_t i = 0;
+  if (n >= 4) {
+    __m256i m = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values));
+    for (i = 4; i + 4 <= n; i += 4) {
+      __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + i));
+      m = _mm256_blendv_epi8(m, x, _mm256_cmpgt_epi64(x, m));
+    }
+    int64_t lanes[4];
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), m);
+    best = *std::max_element(lanes, lanes + 4);
+  }
+  for (; i < n; ++i) {
+    best = std::max(best, values[i]);
+  }
+
+  const __m256i target = _mm256_set1_epi64x(best);
+  for (i = 0; i + 4 <= n; i += 4) {
+    __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + i));
+    unsigned mask = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(x, target)));
+    if (mask) {
+      return i + __builtin_ctz(mask);
+    }
+  }
+  for (; values[i] != best; ++i) {
+  }
+  return i;
+}
+
+CPU_DISPATCH_TARGET_AVX512
+inline size_t first_max_avx512(const int64_t* values, size_t n) {
+  int64_t best = values[0];
+  size_t i = 0;
+  if (n >= 8) {
+    // Blends rather than _mm512_max_epi64 and _mm512_reduce_max_epi64,
+    // whose undefined pass-through operands GCC warns about.
+    __m512i m = _mm512_loadu_si512(values);
+    for (i = 8; i + 8 <= n; i += 8) {
+      __m512i x = _mm512_loadu_si512(values + i);
+      m = _mm512_mask_blend_epi64(_mm512_cmpgt_epi64_mask(x, m), m, x);
+    }
+    int64_t lanes[8];
+    _mm512_storeu_si512(lanes, m);
+    best = *std::max_element(lanes, lanes + 8);
+  }
+  for (; i < n; ++i) {
+    best = std::max(best, values[i]);
+  }
+
+  const __m512i target = _mm512_set1_epi64(best);
+  for (i = 0; i + 8 <= n; i += 8) {
+    unsigned mask = _mm512_cmpeq_epi64_mask(_mm512_loadu_si512(values + i), target);
+    if (mask) {
+      return i + __builtin_ctz(mask);
+    }
+  }
+  for (; values[i] != best; ++i) {
+  }
+  return i;
+}
+
+#endif
+
+// The first_max variant for the instruction set level
+// cpu_dispatch::active() selects.
+inline auto first_max() {
+  using kernel = size_t (*)(const int64_t*, size_t);
+#if CPU_DISPATCH_X86
+  return cpu_dispatch::select<kernel>(first_max_scalar, first_max_sse42,
+                                      first_max_avx2, first_max_avx512);
+#else
+  return kernel(first_max_scalar);
+#endif
+}
+
+}
+// Compute the maximum subarray of input with an exhaustive search that still
+// examines every (begin, end) pair, like max_subarray_exh, but reads each sum
+// from a precomputed prefix-sum array, so it takes O(n^2) time instead of
+// O(n^3). Begin indices are dealt out to threads round-robin, which balances
+// the shrinking number of ends per begin, and the per-thread winners are
+// reduced with max_subarray_exh's tie order, so the result is identical to
+// max_subarray_exh for any number of threads. The scan over the ends of
+// each begin uses the instruction set variant cpu_dispatch selects. input
+// must be nonempty.
+summed_span max_subarray_exh_quadratic(const std::vector<int>& input,
+                                       unsigned threads = std::thread::hardware_concurrency()) {
+
+  assert(!input.empty());
+
+  const std::vector<int64_t> prefix = prefix_sums(input);
+  const size_t n = input.size();
+  threads = std::max(1u, std::min<unsigned>(threads, n));
+
+  struct candidate {
+    int64_t sum;
+    size_t begin, end;
+  };
+  auto ranks_before = [](const candidate& a, const candidate& b) {
+    if (a.sum != b.sum) {
+      return a.sum > b.sum;
+    }
+    return std::tie(a.begin, a.end) < std::tie(b.begin, b.end);
+  };
+
+  // for each begin, the best end is the first one with the greatest prefix sum
+  const auto first_max = kernels::first_max();
+  std::vector<candidate> bests(threads, candidate{input[0], 0, 1});
+  auto worker = [&](unsigned id) {
+    candidate best = bests[id];
+    for (size_t b = id; b < n; b += threads) {
+      size_t e = b + 1 + first_max(prefix.data() + b + 1, n - b);
+      int64_t sum = prefix[e] - prefix[b];
+      if (sum > best.sum) {
+        best = candidate{sum, b, e};
+      }
+    }
+    bests[id] = best;
+  };
+
+  std::vector<std::thread> pool;
+  for (unsigned id = 1; id < threads; ++id) {
+    pool.emplace_back(worker, id);
+  }
+  worker(0);
+  for (auto& thread : pool) {
+    thread.join();
+  }
+
+  candidate best = *std::min_element(bests.begin(), bests.end(), ranks_before);
+  return summed_span(input.begin() + best.begin, input.begin() + best.end, int(best.sum));
+}
+
+// Sparse table over a vector of prefix sums. After O(n log n) preprocessing,
+// argmin(lo, hi) returns the index of the minimum prefix sum in the closed
+// range [lo, hi] in O(1) time. Ties are broken toward the lower index.
+class prefix_min_table {
+private:
+  const std::vector<int64_t>& prefix_;
+  std::vector<std::vector<uint32_t>> levels_;
+
+  uint32_t better(uint32_t a, uint32_t b) const {
+    return (prefix_[b] < prefix_[a] || (prefix_[b] == prefix_[a] && b < a)) ? b : a;
+  }
+
+public:
+  explicit prefix_min_table(const std::vector<int64_t>& prefix)
+  : prefix_(prefix) {
+    assert(!prefix.empty());
+    std::vector<uint32_t> base(prefix.size());
+    std::iota(base.begin(), base.end(), 0);
+    levels_.push_back(std::move(base));
+    for (size_t width = 2; width <= prefix.size(); width *= 2) {
+      const std::vector<uint32_t>& below = levels_.back();
+      std::vector<uint32_t> level(prefix.size() - width + 1);
+      for (size_t i = 0; i < level.size(); ++i) {
+        level[i] = better(below[i], below[i + width / 2]);
+      }
+      levels_.push_back(std::move(level));
+    }
+  }
+
+  size_t argmin(size_t lo, size_t hi) const {
+    assert(lo <= hi && hi < prefix_.size());
+    size_t k = 0;
+    while ((size_t(2) << k) <= hi - lo + 1) {
+      ++k;
+    }
+    return better(levels_[k][lo], levels_[k][hi + 1 - (size_t(1) << k)]);
+  }
+};
+
+// Segment tree of span_summary values, answering "what is the maximum
+// subarray of input[lo, hi)?" in O(log n) time after O(n) preprocessing.
+class span_summary_tree {
+private:
+  size_t leaves_;
+  std::vector<std::optional<span_summary>> nodes_;
+
+  static std::optional<span_summary> combine(const std::optional<span_summary>& left,
+                                             const std::optional<span_summary>& right) {
+    if (!left) {
+      return right;
+    }
+    if (!right) {
+      return left;
+    }
+    return span_summary::merge(*left, *right);
+  }
+
+public:
+  explicit span_summary_tree(const std::vector<int>& input)
+  : leaves_(1) {
+    while (leaves_ < input.size()) {
+      leaves_ *= 2;
+    }
+    nodes_.resize(2 * leaves_);
+    for (size_t i = 0; i < input.size(); ++i) {
+      nodes_[leaves_ + i] = span_summary::leaf(i, input[i]);
+    }
+    for (size_t i = leaves_ - 1; i >= 1; --i) {
+      nodes_[i] = combine(nodes_[2 * i], nodes_[2 * i + 1]);
+    }
+  }
+
+  // Summary of the non-empty range [lo, hi).
+  span_summary query(size_t lo, size_t hi) const {
+    assert(lo < hi && hi <= leaves_);
+    std::optional<span_summary> left, right;
+    for (lo += leaves_, hi += leaves_; lo < hi; lo /= 2, hi /= 2) {
+      if (lo & 1) {
+        left = combine(left, nodes_[lo++]);
+      }
+      if (hi & 1) {
+        right = combine(nodes_[--hi], right);
+      }
+    }
+    return *combine(left, right);
+  }
+};
+
+// Compute the maximum subarray of input[0, n), with the same result as
+// max_subarray_exh, in O(n) time with one thread per partition of
+// numa::for_each_partition(n, threads). Each thread folds its partition into
+// a span_summary, and the partition summaries are merged in order. Merging
+// is associative and keeps max_subarray_exh's tie order, so the result does
+// not depend on the number of threads. When input is a HugeBuffer
+// initialized with the same number of threads, every thread reads memory on
+// its own NUMA node. n must be positive. The sum is kept in 64 bits, so it
+// does not overflow even when an input this long adds up to more than an int
+// holds.
+wide_offset_summed_span
+max_subarray_parallel(const int* input, size_t n,
+                      unsigned threads = std::thread::hardware_concurrency()) {
+
+  assert(n > 0);
+
+  threads = std::max(1u, threads);
+  std::vector<std::optional<span_summary>> parts(threads);
+  numa::for_each_partition(n, threads, [&](unsigned thread, size_t begin, size_t end) {
+    if (begin == end) {
+      return;
+    }
+    span_summary summary = span_summary::leaf(begin, input[begin]);
+    for (size_t i = begin + 1; i < end; ++i) {
+      summary = span_summary::merge(summary, span_summary::leaf(i, input[i]));
+    }
+    parts[thread] = summary;
+  });
+
+  std::optional<span_summary> whole;
+  for (const auto& part : parts) {
+    if (part) {
+      whole = whole ? span_summary::merge(*whole, *part) : *part;
+    }
+  }
+  return wide_offset_summed_span(whole->best_begin, whole->best_end, whole->best);
+}
+
+// Compute the same result as max_subarray_exh, with max_subarray_parallel.
+// The maximum sum must fit in an int.
+summed_span max_subarray_parallel(const std::vector<int>& input,
+                                  unsigned threads = std::thread::hardware_concurrency()) {
+  assert(!input.empty());
+  return max_subarray_parallel(input.data(), input.size(), threads).to_summed_span(input);
+}
+
+// Compute the k subarrays of input with the largest sums. Subarrays may
+// overlap. The result is ordered by decreasing sum; spans with equal sums are
+// ordered by begin, then by end. When input has fewer than k non-empty
+// subarrays, all n(n+1)/2 of them are returned. input must be nonempty.
+//
+// Every subarray [b, e) has sum prefix[e] - prefix[b], so for each end e the
+// best begin is the minimum prefix sum in [0, e-1]. A heap holds one candidate
+// per (end, range of begins); popping a candidate splits its range of begins
+// in two around the chosen begin. With a sparse table answering range minimum
+// queries in O(1), this takes O((n + k) log n) time.
+std::vector<summed_span> max_subarrays_top_k(const std::vector<int>& input, size_t k) {
+
+  assert(!input.empty());
+
+  struct candidate {
+    int64_t sum;
+    size_t begin, end, lo, hi;
+  };
+  // priority_queue pops the greatest element, so "less" here means "ranked
+  // later": smaller sum, or equal sum with a later begin or end.
+  auto ranked_later = [](const candidate& a, const candidate& b) {
+    if (a.sum != b.sum) {
+      return a.sum < b.sum;
+    }
+    if (a.begin != b.begin) {
+      return a.begin > b.begin;
+    }
+    return a.end > b.end;
+  };
+
+  const std::vector<int64_t> prefix = prefix_sums(input);
+  const prefix_min_table table(prefix);
+  auto make_candidate = [&](size_t end, size_t lo, size_t hi) {
+    size_t begin = table.argmin(lo, hi);
+    return candidate{prefix[end] - prefix[begin], begin, end, lo, hi};
+  };
+
+  std::vector<candidate> initial;
+  initial.reserve(input.size());
+  for (size_t end = 1; end <= input.size(); ++end) {
+    initial.push_back(make_candidate(end, 0, end - 1));
+  }
+  std::priority_queue<candidate, std::vector<candidate>, decltype(ranked_later)>
+    heap(ranked_later, std::move(initial));
+
+  std::vector<summed_span> result;
+  while (result.size() < k && !heap.empty()) {
+    candidate top = heap.top();
+    heap.pop();
+    result.emplace_back(input.begin() + top.begin, input.begin() + top.end,
+                        int(top.sum));
+    if (top.begin > top.lo) {
+      heap.push(make_candidate(top.end, top.lo, top.begin - 1));
+    }
+    if (top.begin < top.hi) {
+      heap.push(make_candidate(top.end, top.begin + 1, top.hi));
+    }
+  }
+  return result;
+}
+
+// Compute up to k pairwise disjoint subarrays of input with large sums,
+// chosen greedily: the first is the maximum subarray of input, and each
+// following one is the maximum subarray of whatever remains after removing
+// the spans already chosen. The result is ordered by decreasing sum, and has
+// fewer than k spans only when every element has been used. input must be
+// nonempty.
+//
+// The uncovered gaps are kept in a heap keyed by their own maximum subarray,
+// which a segment tree answers in O(log n) time, so this takes
+// O(n + k log n) time.
+std::vector<summed_span> max_subarrays_top_k_disjoint(const std::vector<int>& input,
+                                                      size_t k) {
 
   assert(!input.empty());
 
-  summed_span result = maximum_subarray_recurse(input, 0, input.size() - 1);
-  
+  struct gap {
+    span_summary summary;
+    size_t lo, hi;
+  };
+  auto ranked_later = [](const gap& a, const gap& b) {
+    if (a.summary.best != b.summary.best) {
+      return a.summary.best < b.summary.best;
+    }
+    return a.summary.best_begin > b.summary.best_begin;
+  };
+
+  const span_summary_tree tree(input);
+  std::priority_queue<gap, std::vector<gap>, decltype(ranked_later)> heap(ranked_later);
+  heap.push({tree.query(0, input.size()), 0, input.size()});
+
+  std::vector<summed_span> result;
+  while (result.size() < k && !heap.empty()) {
+    gap top = heap.top();
+    heap.pop();
+    const span_summary& s = top.summary;
+    result.emplace_back(input.begin() + s.best_begin, input.begin() + s.best_end,
+                        int(s.best));
+    if (top.lo < s.best_begin) {
+      heap.push({tree.query(top.lo, s.best_begin), top.lo, s.best_begin});
+    }
+    if (s.best_end < top.hi) {
+      heap.push({tree.query(s.best_end, top.hi), s.best_end, top.hi});
+    }
+  }
   return result;
 }
 
-// Solve the subset sum problem: return a non-empty subset of input that adds
-// up to exactly target. If no such subset exists, return an empty optional.
-// input must not be empty, and must contain fewer than 64 elements.
-// Note that the returned subset must never be empty, even if target == 0.
-// This uses an exhaustive search algorithm that takes exponential O(n * 2^n)
-// time.
-std::optional<std::vector<int>>subset_sum_exh(const std::vector<int>& input, int target) {
+// Sliding-window minimum over prefix sums, holding candidate begin indices in
+// a monotonic deque backed by a fixed-capacity ring buffer. The front is
+// always the index of the minimum prefix sum in the window, with ties broken
+// toward the lower index.
+class prefix_window_min {
+private:
+  const std::vector<int64_t>& prefix_;
+  std::vector<size_t> ring_;
+  size_t head_, size_;
+
+  size_t& at(size_t i) { return ring_[(head_ + i) % ring_.size()]; }
+
+public:
+  prefix_window_min(const std::vector<int64_t>& prefix, size_t capacity)
+  : prefix_(prefix), ring_(capacity), head_(0), size_(0) {
+    assert(capacity > 0);
+  }
+
+  // Add index to the back of the window. Indices must be added in increasing
+  // order.
+  void push(size_t index) {
+    while (size_ > 0 && prefix_[at(size_ - 1)] > prefix_[index]) {
+      --size_;
+    }
+    assert(size_ < ring_.size());
+    at(size_++) = index;
+  }
+
+  // Drop every index below lowest from the front of the window.
+  void expire(size_t lowest) {
+    while (size_ > 0 && at(0) < lowest) {
+      head_ = (head_ + 1) % ring_.size();
+      --size_;
+    }
+  }
+
+  bool empty() const { return size_ == 0; }
+  size_t min() const { assert(!empty()); return ring_[head_]; }
+};
+
+// Compute, for each (min_length, max_length) pair in bounds, the maximum
+// subarray of input whose size is in [min_length, max_length]. All pairs are
+// answered in a single pass over input, taking O(n * bounds.size()) time.
+// Each pair must satisfy 1 <= min_length <= max_length, and min_length must
+// not exceed the size of input. Ties are broken as in max_subarray_exh:
+// lowest begin, then lowest end.
+std::vector<summed_span>
+max_subarrays_length_bounded(const std::vector<int>& input,
+                             const std::vector<std::pair<size_t, size_t>>& bounds) {
 
   assert(!input.empty());
-  assert(input.size() < 64);
-  int total = 0;
-  int n = input.size();
-  std::optional<std::vector<int>> candidate;
-  for(int bits = 0; bits <= (pow(2, n) - 1); bits++){
-    std::vector<int> vec = {};
-    for(int j = 0; j <= n - 1; j++){
-      if((bits >> j & 1) == 1){
-        vec.push_back(input[j]); 
+
+  const std::vector<int64_t> prefix = prefix_sums(input);
+  const size_t n = input.size();
+
+  struct query {
+    size_t min_length, max_length;
+    prefix_window_min window;
+    std::optional<std::pair<size_t, size_t>> best;
+  };
+  std::vector<query> queries;
+  queries.reserve(bounds.size());
+  for (auto [min_length, max_length] : bounds) {
+    assert(1 <= min_length && min_length <= max_length && min_length <= n);
+    max_length = std::min(max_length, n);
+    queries.push_back({min_length, max_length,
+                       prefix_window_min(prefix, max_length - min_length + 1),
+                       std::nullopt});
+  }
+
+  // For each end e, the allowed begins are [e - max_length, e - min_length];
+  // the best of them has the smallest prefix sum.
+  for (size_t end = 1; end <= n; ++end) {
+    for (query& q : queries) {
+      if (end < q.min_length) {
+        continue;
       }
-      total = accumulate(vec.begin(), vec.end(), 0);
-      
-      if(vec.size() > 0 && total == target){
-        candidate = vec;
-        return candidate; 
+      if (end > q.max_length) {
+        q.window.expire(end - q.max_length);
+      }
+      q.window.push(end - q.min_length);
+      size_t begin = q.window.min();
+      if (!q.best ||
+          prefix[end] - prefix[begin] > prefix[q.best->second] - prefix[q.best->first]) {
+        q.best = std::make_pair(begin, end);
       }
     }
   }
-  return std::nullopt;
- }
+
+  std::vector<summed_span> result;
+  result.reserve(queries.size());
+  for (const query& q : queries) {
+    auto [begin, end] = *q.best;
+    result.emplace_back(input.begin() + begin, input.begin() + end,
+                        int(prefix[end] - prefix[begin]));
+  }
+  return result;
+}
+
+// Compute the maximum subarray of input whose size is between min_length and
+// max_length inclusive, in O(n) time using prefix sums and a monotonic deque.
+// The same preconditions and tie-breaking as max_subarrays_length_bounded
+// apply.
+summed_span max_subarray_length_bounded(const std::vector<int>& input,
+                                        size_t min_length, size_t max_length) {
+  return max_subarrays_length_bounded(input, {{min_length, max_length}}).front();
+}
+
+// A batch of many short int arrays stored in structure-of-arrays layout:
+// element j of array i is at values()[j * count() + i], so the j-th elements of
+// neighbouring arrays are adjacent in memory and can be loaded into one vector
+// register. Arrays shorter than the longest are padded with zeroes, which are
+// ignored. Every array must be nonempty.
+class interleaved_arrays {
+private:
+  std::vector<int> values_;
+  std::vector<uint32_t> lengths_;
+  size_t max_length_;
+
+public:
+
+  // Interleave a list of ordinary arrays. O(total size) time.
+  explicit interleaved_arrays(const std::vector<std::vector<int>>& arrays)
+  : lengths_(arrays.size()), max_length_(0) {
+    for (size_t i = 0; i < arrays.size(); ++i) {
+      assert(!arrays[i].empty());
+      lengths_[i] = arrays[i].size();
+      max_length_ = std::max(max_length_, arrays[i].size());
+    }
+    values_.assign(max_length_ * arrays.size(), 0);
+    for (size_t i = 0; i < arrays.size(); ++i) {
+      for (size_t j = 0; j < arrays[i].size(); ++j) {
+        values_[j * arrays.size() + i] = arrays[i][j];
+      }
+    }
+  }
+
+  // Adopt values that are already interleaved, given the length of each
+  // array. values must hold max(lengths) * lengths.size() elements.
+  interleaved_arrays(std::vector<int> values, std::vector<uint32_t> lengths)
+  : values_(std::move(values)), lengths_(std::move(lengths)), max_length_(0) {
+    for (uint32_t length : lengths_) {
+      assert(length > 0);
+      max_length_ = std::max<size_t>(max_length_, length);
+    }
+    assert(values_.size() == max_length_ * lengths_.size());
+  }
+
+  // Accessors.
+  const std::vector<int>& values() const { return values_; }
+  const std::vector<uint32_t>& lengths() const { return lengths_; }
+  size_t count() const { return lengths_.size(); }
+  size_t max_length() const { return max_length_; }
+};
+
+// Per-array results of max_subarray_batch, also in structure-of-arrays form:
+// the maximum subarray of array i is [begins[i], ends[i]) with sum sums[i].
+struct batch_spans {
+  std::vector<uint32_t> begins, ends;
+  std::vector<int> sums;
+
+  // The result for array i as a compact span.
+  offset_summed_span32 at(size_t i) const {
+    return offset_summed_span32(begins[i], ends[i], sums[i]);
+  }
+};
+
+// Kadane's algorithm run on Lanes neighbouring arrays at once. Every lane
+// executes the same branch-free steps, choosing between values with selects
+// rather than branches. This is the portable form of the
+// kernels::max_subarray_block variants below, which map each step onto one
+// SIMD instruction. Ties are broken as in max_subarray_exh.
+template <size_t Lanes>
+void max_subarray_lanes(const int* values, size_t stride, const uint32_t* lengths,
+                        size_t max_length, uint32_t* begins, uint32_t* ends, int* sums) {
+  int running[Lanes], best[Lanes];
+  uint32_t start[Lanes], best_begin[Lanes], best_end[Lanes], length[Lanes];
+  for (size_t lane = 0; lane < Lanes; ++lane) {
+    running[lane] = 0;
+    best[lane] = std::numeric_limits<int>::min();
+    start[lane] = best_begin[lane] = best_end[lane] = 0;
+    length[lane] = lengths[lane];
+  }
+  for (uint32_t j = 0; j < max_length; ++j) {
+    const int* row = values + j * stride;
+    for (size_t lane = 0; lane < Lanes; ++lane) {
+      bool restart = running[lane] < 0;
+      running[lane] = (restart ? 0 : running[lane]) + row[lane];
+      start[lane] = restart ? j : start[lane];
+      bool better = (j < length[lane]) & (running[lane] > best[lane]);
+      best[lane] = better ? running[lane] : best[lane];
+      best_begin[lane] = better ? start[lane] : best_begin[lane];
+      best_end[lane] = better ? j + 1 : best_end[lane];
+    }
+  }
+  for (size_t lane = 0; lane < Lanes; ++lane) {
+    begins[lane] = best_begin[lane];
+    ends[lane] = best_end[lane];
+    sums[lane] = best[lane];
+  }
+}
+
+// Instruction set variants of max_subarray_lanes<batch_lanes>, which find the
+// maximum subarrays of batch_lanes neighbouring arrays at once. The vector
+// variants hold each piece of per-lane state in batch_lanes / W registers of
+// W 32-bit lanes, and replace the selects with compares and blends, so every
+// step of Kadane's algorithm is one instruction per register.
+namespace kernels {
+
+constexpr size_t batch_lanes = 16;
+
+inline void max_subarray_block_scalar(const int* values, size_t stride, const uint32_t* lengths,
+                                      size_t max_length, uint32_t* begins, uint32_t* ends,
+                                      int* sums) {
+  max_subarray_lanes<batch_lanes>(values, stride, lengths, max_length, begins, ends, sums);
+}
+
+#if CPU_DISPATCH_X86
+
+CPU_DISPATCH_TARGET_SSE42
+inline void max_subarray_block_sse42(const int* values, size_t stride, const uint32_t* lengths,
+                                     size_t max_length, uint32_t* begins, uint32_t* ends,
+                                     int* sums) {
+  constexpr size_t registers = batch_lanes / 4;
+  __m128i running[registers], best[registers], start[registers], best_begin[registers],
+          best_end[registers], length[registers];
+  for (size_t r = 0; r < registers; ++r) {
+    running[r] = start[r] = best_begin[r] = best_end[r] = _mm_setzero_si128();
+    best[r] = _mm_set1_epi32(std::numeric_limits<int>::min());
+    length[r] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(lengths + 4 * r));
+  }
+  const __m128i zero = _mm_setzero_si128();
+  for (uint32_t j = 0; j < max_length; ++j) {
+    const int* row = values + j * stride;
+    const __m128i index = _mm_set1_epi32(j), next = _mm_set1_epi32(j + 1);
+    for (size_t r = 0; r < registers; ++r) {
+      __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + 4 * r));
+      __m128i restart = _mm_cmpgt_epi32(zero, running[r]);
+      running[r] = _mm_add_epi32(_mm_andnot_si128(restart, running[r]), x);
+      start[r] = _mm_blendv_epi8(start[r], index, restart);
+      __m128i better = _mm_and_si128(_mm_cmpgt_epi32(length[r], index),
+                                     _mm_cmpgt_epi32(running[r], best[r]));
+      best[r] = _mm_blendv_epi8(best[r], running[r], better);
+      best_begin[r] = _mm_blendv_epi8(best_begin[r], start[r], better);
+      best_end[r] = _mm_blendv_epi8(best_end[r], next, better);
+    }
+  }
+  for (size_t r = 0; r < registers; ++r) {
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(begins + 4 * r), best_begin[r]);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(ends + 4 * r), best_end[r]);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(sums + 4 * r), best[r]);
+  }
+}
+
+CPU_DISPATCH_TARGET_AVX2
+inline void max_subarray_block_avx2(const int* values, size_t stride, const uint32_t* lengths,
+                                    size_t max_length, uint32_t* begins, uint32_t* ends,
+                                    int* sums) {
+  constexpr size_t registers = batch_lanes / 8;
+  __m256i running[registers], best[registers], start[registers], best_begin[registers],
+          best_end[registers], length[registers];
+  for (size_t r = 0; r < registers; ++r) {
+    running[r] = start[r] = best_begin[r] = best_end[r] = _mm256_setzero_si256();
+    best[r] = _mm256_set1_epi32(std::numeric_limits<int>::min());
+    length[r] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(lengths + 8 * r));
+  }
+  const __m256i zero = _mm256_setzero_si256();
+  for (uint32_t j = 0; j < max_length; ++j) {
+    const int* row = values + j * stride;
+    const __m256i index = _mm256_set1_epi32(j), next = _mm256_set1_epi32(j + 1);
+    for (size_t r = 0; r < registers; ++r) {
+      __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + 8 * r));
+      __m256i restart = _mm256_cmpgt_epi32(zero, running[r]);
+      running[r] = _mm256_add_epi32(_mm256_andnot_si256(restart, running[r]), x);
+      start[r] = _mm256_blendv_epi8(start[r], index, restart);
+      __m256i better = _mm256_and_si256(_mm256_cmpgt_epi32(length[r], index),
+                                        _mm256_cmpgt_epi32(running[r], best[r]));
+      best[r] = _mm256_blendv_epi8(best[r], running[r], better);
+      best_begin[r] = _mm256_blendv_epi8(best_begin[r], start[r], better);
+      best_end[r] = _mm256_blendv_epi8(best_end[r], next, better);
+    }
+  }
+  for (size_t r = 0; r < registers; ++r) {
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(begins + 8 * r), best_begin[r]);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(ends + 8 * r), best_end[r]);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(sums + 8 * r), best[r]);
+  }
+}
+
+CPU_DISPATCH_TARGET_AVX512
+inline void max_subarray_block_avx512(const int* values, size_t stride, const uint32_t* lengths,
+                                      size_t max_length, uint32_t* begins, uint32_t* ends,
+                                      int* sums) {
+  static_assert(batch_lanes == 16, "one AVX-512 register holds the whole block");
+  __m512i running = _mm512_setzero_si512(), start = _mm512_setzero_si512(),
+          best_begin = _mm512_setzero_si512(), best_end = _mm512_setzero_si512(),
+          best = _mm512_set1_epi32(std::numeric_limits<int>::min()),
+          length = _mm512_loadu_si512(lengths);
+  const __m512i zero = _mm512_setzero_si512();
+  for (uint32_t j = 0; j < max_length; ++j) {
+    const __m512i index = _mm512_set1_epi32(j), next = _mm512_set1_epi32(j + 1);
+    __m512i x = _mm512_loadu_si512(values + j * stride);
+    __mmask16 restart = _mm512_cmpgt_epi32_mask(zero, running);
+    running = _mm512_add_epi32(_mm512_mask_blend_epi32(restart, running, zero), x);
+    start = _mm512_mask_blend_epi32(restart, start, index);
+    __mmask16 better = _mm512_mask_cmpgt_epi32_mask(_mm512_cmpgt_epi32_mask(length, index),
+                                                    running, best);
+    best = _mm512_mask_blend_epi32(better, best, running);
+    best_begin = _mm512_mask_blend_epi32(better, best_begin, start);
+    best_end = _mm512_mask_blend_epi32(better, best_end, next);
+  }
+  _mm512_storeu_si512(begins, best_begin);
+  _mm512_storeu_si512(ends, best_end);
+  _mm512_storeu_si512(sums, best);
+}
+
+#endif
+
+// The max_subarray_block variant for the instruction set level
+// cpu_dispatch::active() selects.
+inline auto max_subarray_block() {
+  using kernel = void (*)(const int*, size_t, const uint32_t*, size_t, uint32_t*, uint32_t*,
+                          int*);
+#if CPU_DISPATCH_X86
+  return cpu_dispatch::select<kernel>(max_subarray_block_scalar, max_subarray_block_sse42,
+                                      max_subarray_block_avx2, max_subarray_block_avx512);
+#else
+  return kernel(max_subarray_block_scalar);
+#endif
+}
+
+}
+
+// Compute the maximum subarray of every array in batch. Arrays are processed
+// kernels::batch_lanes at a time, one per SIMD lane, with the instruction set
+// variant cpu_dispatch selects, so throughput grows with vector width rather
+// than with the number of calls; leftover arrays are processed one at a time.
+// Takes O(count * max_length) time. Results are identical to calling
+// max_subarray_exh on each array. Sums must fit in an int, and lengths must
+// be below 2^31.
+batch_spans max_subarray_batch(const interleaved_arrays& batch) {
+
+  constexpr size_t lanes = kernels::batch_lanes;
+  const size_t count = batch.count();
+  batch_spans result;
+  result.begins.resize(count);
+  result.ends.resize(count);
+  result.sums.resize(count);
+
+  const auto block = kernels::max_subarray_block();
+  size_t i = 0;
+  for (; i + lanes <= count; i += lanes) {
+    block(batch.values().data() + i, count, batch.lengths().data() + i, batch.max_length(),
+          result.begins.data() + i, result.ends.data() + i, result.sums.data() + i);
+  }
+  for (; i < count; ++i) {
+    max_subarray_lanes<1>(batch.values().data() + i, count, batch.lengths().data() + i,
+                          batch.max_length(), result.begins.data() + i,
+                          result.ends.data() + i, result.sums.data() + i);
+  }
+  return result;
+}
+
+// A summed_rectangle is the result of a two-dimensional maximum subarray
+// search: the rows [top, bottom) and columns [left, right) of a row-major
+// grid, and the sum of the elements inside. Like summed_span, both ranges are
+// half-open and non-empty.
+struct summed_rectangle {
+  size_t top, left, bottom, right;
+  int64_t sum;
+
+  bool operator== (const summed_rectangle& rhs) const {
+    return (top == rhs.top) && (left == rhs.left) &&
+           (bottom == rhs.bottom) && (right == rhs.right);
+  }
+
+  // Orders rectangles the way max_submatrix breaks ties: larger sum first,
+  // then by top, left, bottom and right.
+  bool ranks_before(const summed_rectangle& rhs) const {
+    if (sum != rhs.sum) {
+      return sum > rhs.sum;
+    }
+    return std::tie(top, left, bottom, right) <
+           std::tie(rhs.top, rhs.left, rhs.bottom, rhs.right);
+  }
+
+  friend std::ostream& operator<<(std::ostream& stream, const summed_rectangle& rhs) {
+    stream << "summed_rectangle, rows=[" << rhs.top << ", " << rhs.bottom
+           << "), cols=[" << rhs.left << ", " << rhs.right << "), sum=" << rhs.sum;
+    return stream;
+  }
+};
+
+// Instruction set variants of the column accumulation in max_submatrix. Each
+// adds row[c] to sums[c] for every c in [0, n), widening the ints to 64 bits
+// one vector at a time.
+namespace kernels {
+
+inline void add_row_scalar(int64_t* sums, const int* row, size_t n) {
+  for (size_t c = 0; c < n; ++c) {
+    sums[c] += row[c];
+  }
+}
+
+#if CPU_DISPATCH_X86
+
+CPU_DISPATCH_TARGET_SSE42
+inline void add_row_sse42(int64_t* sums, const int* row, size_t n) {
+  size_t c = 0;
+  for (; c + 4 <= n; c += 4) {
+    __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + c));
+    __m128i* out = reinterpret_cast<__m128i*>(sums + c);
+    _mm_storeu_si128(out, _mm_add_epi64(_mm_loadu_si128(out), _mm_cvtepi32_epi64(x)));
+    _mm_storeu_si128(out + 1, _mm_add_epi64(_mm_loadu_si128(out + 1),
+                                            _mm_cvtepi32_epi64(_mm_srli_si128(x, 8))));
+  }
+  for (; c < n; ++c) {
+    sums[c] += row[c];
+  }
+}
+
+CPU_DISPATCH_TARGET_AVX2
+inline void add_row_avx2(int64_t* sums, const int* row, size_t n) {
+  size_t c = 0;
+  for (; c + 8 <= n; c += 8) {
+    __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + c));
+    __m256i* out = reinterpret_cast<__m256i*>(sums + c);
+    _mm256_storeu_si256(out, _mm256_add_epi64(_mm256_loadu_si256(out),
+                                              _mm256_cvtepi32_epi64(_mm256_castsi256_si128(x))));
+    _mm256_storeu_si256(out + 1, _mm256_add_epi64(_mm256_loadu_si256(out + 1),
+                                                  _mm256_cvtepi32_epi64(_mm256_extracti128_si256(x, 1))));
+  }
+  for (; c < n; ++c) {
+    sums[c] += row[c];
+  }
+}
+
+CPU_DISPATCH_TARGET_AVX512
+inline void add_row_avx512(int64_t* sums, const int* row, size_t n) {
+  size_t c = 0;
+  for (; c + 8 <= n; c += 8) {
+    // The zero-masked conversion, with every lane enabled, is the plain one
+    // without the undefined pass-through value GCC warns about.
+    __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + c));
+    _mm512_storeu_si512(sums + c, _mm512_add_epi64(_mm512_loadu_si512(sums + c),
+                                                   _mm512_maskz_cvtepi32_epi64(0xff, x)));
+  }
+  for (; c < n; ++c) {
+    sums[c] += row[c];
+  }
+}
+
+#endif
+
+// The add_row variant for the instruction set level cpu_dispatch::active()
+// selects.
+inline auto add_row() {
+  using kernel = void (*)(int64_t*, const int*, size_t);
+#if CPU_DISPATCH_X86
+  return cpu_dispatch::select<kernel>(add_row_scalar, add_row_sse42,
+                                      add_row_avx2, add_row_avx512);
+#else
+  return kernel(add_row_scalar);
+#endif
+}
+
+}
+
+// Compute the maximum-sum submatrix of a grid with the given number of rows
+// and columns, stored in row-major order. grid must be nonempty. Among
+// rectangles with equal sums, the one with the lowest top, then left, bottom
+// and right is returned, no matter how many threads are used.
+//
+// For every pair of rows (top, bottom), the elements between them are
+// compressed into one vector of column sums, which is accumulated one row at a
+// time as bottom advances, and Kadane's algorithm finds the best column range
+// in that vector. The accumulation uses the instruction set variant
+// cpu_dispatch selects. Each top row is one task; worker threads claim tasks
+// from a shared atomic counter, so threads that finish early keep taking
+// work. This takes O(rows^2 * cols) time, so pass the grid with the shorter
+// dimension as rows.
+summed_rectangle max_submatrix(const std::vector<int>& grid, size_t rows, size_t cols,
+                               unsigned threads = std::thread::hardware_concurrency()) {
+
+  assert(rows > 0 && cols > 0);
+  assert(grid.size() == rows * cols);
+
+  threads = std::max(1u, std::min<unsigned>(threads, rows));
+  std::atomic<size_t> next_top(0);
+  std::vector<summed_rectangle> bests(threads, summed_rectangle{0, 0, 1, 1, grid[0]});
+
+  const auto add_row = kernels::add_row();
+  auto worker = [&](summed_rectangle& best) {
+    std::vector<int64_t> column_sums(cols);
+    for (size_t top; (top = next_top++) < rows; ) {
+      std::fill(column_sums.begin(), column_sums.end(), 0);
+      for (size_t bottom = top + 1; bottom <= rows; ++bottom) {
+        add_row(column_sums.data(), grid.data() + (bottom - 1) * cols, cols);
+        // Kadane's algorithm. Only restart when the running sum is negative,
+        // and only accept strictly larger sums, so each row pair yields its
+        // lowest (left, right) among equal sums. Only a sum at least as
+        // large as the best so far needs the full tie-breaking comparison.
+        int64_t running = 0;
+        size_t left = 0;
+        for (size_t c = 0; c < cols; ++c) {
+          if (running < 0) {
+            running = 0;
+            left = c;
+          }
+          running += column_sums[c];
+          if (running >= best.sum) {
+            summed_rectangle candidate{top, left, bottom, c + 1, running};
+            if (candidate.ranks_before(best)) {
+              best = candidate;
+            }
+          }
+        }
+      }
+    }
+  };
+
+  std::vector<std::thread> pool;
+  for (unsigned i = 1; i < threads; ++i) {
+    pool.emplace_back(worker, std::ref(bests[i]));
+  }
+  worker(bests[0]);
+  for (auto& thread : pool) {
+    thread.join();
+  }
+
+  return *std::min_element(bests.begin(), bests.end(),
+                           [](const auto& a, const auto& b) { return a.ranks_before(b); });
+}
+
+// Solve the subset sum problem: return a non-empty subset of input that adds
+// up to exactly target. If no such subset exists, return an empty optional.
+// input must not be empty, and must contain fewer than 64 elements.
+// Note that the returned subset must never be empty, even if target == 0.
+// This uses an exhaustive search algorithm that takes exponential O(n * 2^n)
+// time.
+std::optional<std::vector<int>>subset_sum_exh(const std::vector<int>& input, int target) {
+
+  assert(!input.empty());
+  assert(input.size() < 64);
+  int64_t total = 0;
+  int n = input.size();
+  std::optional<std::vector<int>> candidate;
+  for(uint64_t bits = 0; bits <= (uint64_t(1) << n) - 1; bits++){
+    std::vector<int> vec = {};
+    for(int j = 0; j <= n - 1; j++){
+      if((bits >> j & 1) == 1){
+        vec.push_back(input[j]); 
+      }
+      total = accumulate(vec.begin(), vec.end(), int64_t(0));
+      
+      if(vec.size() > 0 && total == target){
+        candidate = vec;
+        return candidate; 
+      }
+    }
+  }
+  return std::nullopt;
+ }
+
+// A subset of at most N elements held in place, so that it can be returned
+// from a constexpr function. The first size elements of values are the
+// subset.
+template <size_t N>
+struct fixed_subset {
+  std::array<int, N> values;
+  size_t size;
+
+  std::vector<int> to_vector() const {
+    return std::vector<int>(values.begin(), values.begin() + size);
+  }
+};
+
+// Solve the subset sum problem for a fixed-size array, with the same contract
+// as subset_sum_exh. Visits all 2^N masks in Gray code order, so that
+// consecutive masks differ in one element and each sum is updated in O(1);
+// the loop bounds are compile-time constants, so the compiler can unroll it.
+// Usable in constexpr contexts. Elements are returned in input order.
+template <size_t N>
+constexpr std::optional<fixed_subset<N>> subset_sum_exh(const std::array<int, N>& input,
+                                                        int target) {
+  static_assert(N > 0 && N < 64, "input must have between 1 and 63 elements");
+  int64_t sum = 0;
+  uint64_t mask = 0;
+  for (uint64_t step = 1; step < (uint64_t(1) << N); ++step) {
+    // Going from Gray code step - 1 to step flips the lowest set bit of step.
+    size_t flipped = 0;
+    while (((step >> flipped) & 1) == 0) {
+      ++flipped;
+    }
+    mask ^= uint64_t(1) << flipped;
+    sum += ((mask >> flipped) & 1) ? input[flipped] : -int64_t(input[flipped]);
+    if (sum == target) {
+      fixed_subset<N> subset{};
+      for (size_t j = 0; j < N; ++j) {
+        if ((mask >> j) & 1) {
+          subset.values[subset.size++] = input[j];
+        }
+      }
+      return subset;
+    }
+  }
+  return std::nullopt;
+}
+
+// Largest input routed to the fixed-size subset_sum_exh by
+// subset_sum_exh_auto.
+constexpr size_t subset_sum_fixed_limit = 16;
+
+// Solve the subset sum problem with the same contract as subset_sum_exh,
+// routing inputs of at most subset_sum_fixed_limit elements to the
+// fixed-size search.
+std::optional<std::vector<int>> subset_sum_exh_auto(const std::vector<int>& input, int target) {
+
+  assert(!input.empty());
+
+  if (input.size() > subset_sum_fixed_limit) {
+    return subset_sum_exh(input, target);
+  }
+  return fixed_size::call<1, subset_sum_fixed_limit>(
+    input, [target](const auto& values) -> std::optional<std::vector<int>> {
+      if (auto subset = subset_sum_exh(values, target)) {
+        return subset->to_vector();
+      }
+      return std::nullopt;
+    });
+}
+
+// Results of subset_sum_exh, keyed by the contents of the input and the
+// target.
+using subset_sum_cache = result_cache::ResultCache<std::optional<std::vector<int>>>;
+
+// Solve the subset sum problem with the same result as subset_sum_exh,
+// answering repeated queries for the same input contents and target from
+// cache.
+std::optional<std::vector<int>> subset_sum_exh_memo(const std::vector<int>& input, int target,
+                                                    subset_sum_cache& cache) {
+  result_cache::CacheKey key =
+    result_cache::KeyHasher("subset_sum_exh").add_array(input).add(target).key();
+  return cache.get_or_compute(key, [&] { return subset_sum_exh(input, target); });
+}
+
+// Return the elements of input whose indices are set in mask, in input order.
+std::vector<int> subset_from_mask(const std::vector<int>& input, uint64_t mask) {
+  std::vector<int> subset;
+  for (size_t j = 0; j < input.size(); ++j) {
+    if ((mask >> j) & 1) {
+      subset.push_back(input[j]);
+    }
+  }
+  return subset;
+}
+
+// Whether subset is a non-empty sub-multiset of input adding up to target,
+// that is, a valid answer from any of the subset sum solvers here. O(n log n)
+// time.
+bool is_subset_sum_solution(const std::vector<int>& input, const std::vector<int>& subset,
+                            int64_t target) {
+  if (subset.empty() || std::accumulate(subset.begin(), subset.end(), int64_t(0)) != target) {
+    return false;
+  }
+  std::vector<int> sorted_input(input), sorted_subset(subset);
+  std::sort(sorted_input.begin(), sorted_input.end());
+  std::sort(sorted_subset.begin(), sorted_subset.end());
+  return std::includes(sorted_input.begin(), sorted_input.end(),
+                       sorted_subset.begin(), sorted_subset.end());
+}
+
+// Progress of a subset_sum_exh_resumable run, as passed to its on_progress
+// callback. masks_done counts masks examined in this and any earlier runs
+// that were resumed from a checkpoint; masks_per_second measures this run
+// only.
+struct exh_progress {
+  uint64_t masks_done, masks_total;
+  double elapsed_seconds, masks_per_second;
+};
+
+// Settings for subset_sum_exh_resumable. With an empty checkpoint_path no
+// checkpoint is read or written. When stop is non-null and becomes true, the
+// workers finish their current slice of masks, a final checkpoint is written,
+// and the search returns unfinished.
+struct exh_resumable_options {
+  std::string checkpoint_path;
+  unsigned threads = 1;
+  std::chrono::duration<double> checkpoint_interval = std::chrono::seconds(10);
+  uint64_t masks_per_slice = uint64_t(1) << 16;
+  std::function<void(const exh_progress&)> on_progress;
+  const std::atomic<bool>* stop = nullptr;
+};
+
+// Result of subset_sum_exh_resumable. finished is false only if the search
+// was stopped before either finding a subset or examining every mask.
+struct exh_resumable_result {
+  bool finished;
+  std::optional<std::vector<int>> subset;
+};
+
+// 64-bit FNV-1a hash of a subset sum instance, stored in checkpoints so that
+// a checkpoint is only ever resumed against the same input and target.
+uint64_t subset_sum_fingerprint(const std::vector<int>& input, int target) {
+  uint64_t hash = 14695981039346656037ull;
+  auto mix = [&](int64_t value) {
+    for (int byte = 0; byte < 8; ++byte) {
+      hash = (hash ^ ((uint64_t(value) >> (8 * byte)) & 0xff)) * 1099511628211ull;
+    }
+  };
+  mix(input.size());
+  mix(target);
+  for (int x : input) {
+    mix(x);
+  }
+  return hash;
+}
+
+// Exhaustive subset sum search over every non-empty mask in [1, 2^n), with
+// the same contract as subset_sum_exh but meant for runs lasting hours:
+//
+// - Masks are uint64_t, so every n < 64 works. Consecutive masks differ in
+//   their trailing bits only, so each sum is updated from the previous one in
+//   O(1) amortized time, and the whole search takes O(2^n) time.
+// - The mask range is divided into one contiguous range per thread. Every
+//   checkpoint_interval the calling thread atomically replaces the checkpoint
+//   file with the instance fingerprint and each worker's next and end mask,
+//   and reports progress through on_progress.
+// - If checkpoint_path names a checkpoint for the same input and target, the
+//   search resumes from it, with the thread count it was written with. A
+//   checkpoint for a different instance is ignored and overwritten. The
+//   checkpoint is removed once the search finishes.
+//
+// With more than one thread, the subset returned is whichever one a worker
+// finds first.
+exh_resumable_result subset_sum_exh_resumable(const std::vector<int>& input, int target,
+                                              const exh_resumable_options& options = {}) {
+
+  assert(!input.empty());
+  assert(input.size() < 64);
+  assert(options.masks_per_slice > 0);
+
+  using clock = std::chrono::steady_clock;
+  const size_t n = input.size();
+  const uint64_t last = (uint64_t(1) << n) - 1;
+  const uint64_t fingerprint = subset_sum_fingerprint(input, target);
+
+  // Each worker examines masks [next, end).
+  std::vector<uint64_t> begins, ends;
+  if (!options.checkpoint_path.empty()) {
+    std::ifstream file(options.checkpoint_path);
+    std::string magic;
+    uint64_t saved_fingerprint = 0, workers = 0;
+    if (std::getline(file, magic) && magic == "subset_sum_exh checkpoint 1" &&
+        file >> saved_fingerprint >> workers && saved_fingerprint == fingerprint) {
+      begins.resize(workers);
+      ends.resize(workers);
+      for (uint64_t w = 0; w < workers; ++w) {
+        file >> begins[w] >> ends[w];
+      }
+      if (!file || workers == 0) {
+        begins.clear();
+        ends.clear();
+      }
+    }
+  }
+  if (begins.empty()) {
+    const uint64_t workers = std::max(1u, options.threads);
+    for (uint64_t w = 0; w < workers; ++w) {
+      begins.push_back(1 + (last / workers) * w + std::min(w, last % workers));
+      ends.push_back(1 + (last / workers) * (w + 1) + std::min(w + 1, last % workers));
+    }
+  }
+  const size_t workers = begins.size();
+  uint64_t remaining_at_start = 0;
+  for (size_t w = 0; w < workers; ++w) {
+    remaining_at_start += ends[w] - begins[w];
+  }
+
+  // prefix[t] is the sum of input[0, t), the amount subtracted when the t
+  // trailing one bits of a mask are cleared by incrementing it.
+  std::vector<int64_t> prefix = prefix_sums(input);
+
+  std::vector<std::atomic<uint64_t>> next(workers);
+  std::atomic<bool> found(false);
+  std::atomic<uint64_t> found_mask(0);
+  std::mutex mutex;
+  std::condition_variable done;
+  size_t running = workers;
+  auto stopped = [&]() {
+    return found.load() || (options.stop && options.stop->load());
+  };
+
+  auto worker = [&](size_t w) {
+    uint64_t mask = begins[w];
+    int64_t sum = 0;
+    for (size_t j = 0; j < n; ++j) {
+      if ((mask >> j) & 1) {
+        sum += input[j];
+      }
+    }
+    while (mask < ends[w] && !stopped()) {
+      const uint64_t slice_end = std::min(ends[w], mask + options.masks_per_slice);
+      for (; mask < slice_end; ++mask) {
+        if (sum == target) {
+          uint64_t expected = 0;
+          found_mask.compare_exchange_strong(expected, mask);
+          found = true;
+          break;
+        }
+        size_t t = __builtin_ctzll(mask + 1);
+        if (t < n) {
+          sum += input[t] - prefix[t];
+        }
+      }
+      next[w] = mask;
+    }
+    next[w] = mask;
+    std::lock_guard<std::mutex> lock(mutex);
+    --running;
+    done.notify_all();
+  };
+
+  auto write_checkpoint = [&]() {
+    if (options.checkpoint_path.empty()) {
+      return;
+    }
+    const std::string temporary = options.checkpoint_path + ".tmp";
+    {
+      std::ofstream file(temporary, std::ios::trunc);
+      file << "subset_sum_exh checkpoint 1\n" << fingerprint << ' ' << workers << '\n';
+      for (size_t w = 0; w < workers; ++w) {
+        file << next[w] << ' ' << ends[w] << '\n';
+      }
+    }
+    std::rename(temporary.c_str(), options.checkpoint_path.c_str());
+  };
+
+  const auto start = clock::now();
+  auto report = [&]() {
+    uint64_t remaining = 0;
+    for (size_t w = 0; w < workers; ++w) {
+      remaining += ends[w] - next[w];
+    }
+    double elapsed = std::chrono::duration<double>(clock::now() - start).count();
+    uint64_t done_now = remaining_at_start - remaining;
+    if (options.on_progress) {
+      options.on_progress({last - remaining, last, elapsed,
+                           elapsed > 0 ? done_now / elapsed : 0.0});
+    }
+    return remaining;
+  };
+
+  for (size_t w = 0; w < workers; ++w) {
+    next[w] = begins[w];
+  }
+  std::vector<std::thread> pool;
+  for (size_t w = 0; w < workers; ++w) {
+    pool.emplace_back(worker, w);
+  }
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (running > 0) {
+      if (!done.wait_for(lock, options.checkpoint_interval, [&] { return running == 0; })) {
+        lock.unlock();
+        write_checkpoint();
+        report();
+        lock.lock();
+      }
+    }
+  }
+  for (auto& thread : pool) {
+    thread.join();
+  }
+
+  uint64_t remaining = report();
+  if (found) {
+    if (!options.checkpoint_path.empty()) {
+      std::remove(options.checkpoint_path.c_str());
+    }
+    return {true, subset_from_mask(input, found_mask)};
+  }
+  if (remaining == 0) {
+    if (!options.checkpoint_path.empty()) {
+      std::remove(options.checkpoint_path.c_str());
+    }
+    return {true, std::nullopt};
+  }
+  write_checkpoint();
+  return {false, std::nullopt};
+}
+
+// Depth-first search state for subset_sum_bnb. Elements are visited in
+// decreasing order of value; suffix_min[i] and suffix_max[i] are the least
+// and greatest sums that elements i..n-1 can still contribute, and
+// next_distinct[i] is the first element after i with a different value.
+struct subset_sum_search {
+  // A branch that took values[index], when the sum before it was sum.
+  struct frame {
+    size_t index;
+    int64_t sum;
+  };
+
+  std::vector<int> values;
+  std::vector<size_t> original_index;
+  std::vector<int64_t> suffix_min, suffix_max;
+  std::vector<size_t> next_distinct;
+  std::vector<frame> taken;
+  int64_t target;
+
+  // Search with an explicit stack of taken branches, so that the depth, up
+  // to n, costs heap memory rather than call stack.
+  bool search() {
+    size_t i = 0;
+    int64_t sum = 0;
+    for (;;) {
+      if (sum == target && !taken.empty()) {
+        return true;
+      }
+      const int64_t needed = target - sum;
+      if (i < values.size() && needed >= suffix_min[i] && needed <= suffix_max[i]) {
+        taken.push_back({i, sum});
+        sum += values[i];
+        ++i;
+        continue;
+      }
+      if (taken.empty()) {
+        return false;
+      }
+
+      // Undo the latest take and skip that element instead. Any solution
+      // that skips it but uses a later copy of the same value was already
+      // found with the element itself, so skip every copy.
+      const frame last = taken.back();
+      taken.pop_back();
+      i = next_distinct[last.index];
+      sum = last.sum;
+    }
+  }
+};
+
+// Solve the subset sum problem with the same contract as subset_sum_exh, but
+// by branch and bound: a depth-first search over elements sorted in
+// decreasing order, which abandons any subtree whose reachable sums, bounded
+// by precomputed suffix sums of the remaining negative and positive elements,
+// cannot include target. The worst case is still O(2^n), but on inputs that
+// are mostly positive most subtrees are cut off early, so n is not limited to
+// 64 as with masks. The search keeps its own stack, so a long input cannot
+// overflow the call stack. Elements are returned in input order.
+std::optional<std::vector<int>> subset_sum_bnb(const std::vector<int>& input, int target) {
+
+  assert(!input.empty());
+
+  const size_t n = input.size();
+  subset_sum_search state;
+  state.original_index.resize(n);
+  std::iota(state.original_index.begin(), state.original_index.end(), 0);
+  std::stable_sort(state.original_index.begin(), state.original_index.end(),
+                   [&](size_t a, size_t b) { return input[a] > input[b]; });
+  for (size_t index : state.original_index) {
+    state.values.push_back(input[index]);
+  }
+  state.suffix_min.assign(n + 1, 0);
+  state.suffix_max.assign(n + 1, 0);
+  state.next_distinct.assign(n, n);
+  for (size_t i = n; i-- > 0; ) {
+    state.suffix_min[i] = state.suffix_min[i + 1] + std::min(state.values[i], 0);
+    state.suffix_max[i] = state.suffix_max[i + 1] + std::max(state.values[i], 0);
+    if (i + 1 < n && state.values[i + 1] == state.values[i]) {
+      state.next_distinct[i] = state.next_distinct[i + 1];
+    } else if (i + 1 < n) {
+      state.next_distinct[i] = i + 1;
+    }
+  }
+  state.target = target;
+
+  if (!state.search()) {
+    return std::nullopt;
+  }
+
+  std::vector<size_t> indices;
+  for (const auto& taken : state.taken) {
+    indices.push_back(state.original_index[taken.index]);
+  }
+  std::sort(indices.begin(), indices.end());
+  std::vector<int> subset;
+  for (size_t index : indices) {
+    subset.push_back(input[index]);
+  }
+  return subset;
+}
+
+// A half_sum is the sum of one subset of half of an input, and the mask of
+// indices (relative to the start of that half) that form the subset.
+struct half_sum {
+  int64_t sum;
+  uint32_t mask;
+};
+
+// Every subset sum of input[first, last), sorted by sum, in O(2^n) time and
+// without a comparison sort: the sums of the first j elements are merged with
+// the same sums shifted by element j. Among equal sums the empty subset comes
+// first.
+std::vector<half_sum> sorted_half_sums(const std::vector<int>& input,
+                                       size_t first, size_t last) {
+  assert(last - first < 32);
+  std::vector<half_sum> sums{{0, 0}}, merged;
+  for (size_t j = first; j < last; ++j) {
+    const int x = input[j];
+    const uint32_t bit = uint32_t(1) << (j - first);
+    merged.resize(2 * sums.size());
+    size_t a = 0, b = 0, out = 0;
+    while (a < sums.size() || b < sums.size()) {
+      if (b == sums.size() || (a < sums.size() && sums[a].sum <= sums[b].sum + x)) {
+        merged[out++] = sums[a++];
+      } else {
+        merged[out++] = {sums[b].sum + x, sums[b].mask | bit};
+        ++b;
+      }
+    }
+    sums.swap(merged);
+  }
+  return sums;
+}
+
+// A reusable index over one subset sum input, for answering many targets.
+//
+// The input is split into two halves, and the 2^(n/2) subset sums of each half
+// are stored sorted in contiguous arrays (meet in the middle). Building the
+// index takes O(2^(n/2)) time and space; each query is then a linear sweep of
+// the two arrays toward each other, taking O(2^(n/2)) time instead of the
+// O(n * 2^n) of subset_sum_exh.
+class subset_sum_index {
+private:
+  std::vector<int> input_;
+  size_t split_;
+  std::vector<half_sum> left_, right_;
+
+  // Given indices whose sums add up to a target, return a non-empty
+  // combination with the same total. Only when both are the empty subset
+  // does a neighbour with an equal sum need to be chosen instead.
+  std::optional<std::pair<size_t, size_t>> nonempty_match(size_t i, size_t j) const {
+    if (left_[i].mask != 0 || right_[j].mask != 0) {
+      return std::make_pair(i, j);
+    }
+    if (i + 1 < left_.size() && left_[i + 1].sum == left_[i].sum) {
+      return std::make_pair(i + 1, j);
+    }
+    if (j > 0 && right_[j - 1].sum == right_[j].sum) {
+      return std::make_pair(i, j - 1);
+    }
+    return std::nullopt;
+  }
+
+  std::vector<int> subset(std::pair<size_t, size_t> match) const {
+    uint64_t mask = left_[match.first].mask |
+                    (uint64_t(right_[match.second].mask) << split_);
+    return subset_from_mask(input_, mask);
+  }
+
+  // The indices of a left and a right sum making up target, found by one
+  // O(2^(n/2)) sweep down the right sums as the left sums increase.
+  std::optional<std::pair<size_t, size_t>> match(int target) const {
+    size_t i = 0, j = right_.size();
+    while (i < left_.size() && j > 0) {
+      int64_t sum = left_[i].sum + right_[j - 1].sum;
+      if (sum < target) {
+        ++i;
+      } else if (sum > target) {
+        --j;
+      } else if (auto found = nonempty_match(i, j - 1)) {
+        return found;
+      } else {
+        ++i;
+      }
+    }
+    return std::nullopt;
+  }
+
+public:
+
+  // Build the index. input must not be empty, and must contain at most 62
+  // elements.
+  explicit subset_sum_index(const std::vector<int>& input)
+  : input_(input), split_(input.size() / 2) {
+    assert(!input.empty());
+    assert(input.size() <= 62);
+    left_ = sorted_half_sums(input_, 0, split_);
+    right_ = sorted_half_sums(input_, split_, input_.size());
+  }
+
+  // Same contract as subset_sum_exh: return a non-empty subset of the input
+  // that adds up to exactly target, or an empty optional if there is none.
+  // Elements are returned in input order.
+  std::optional<std::vector<int>> find(int target) const {
+    if (auto found = match(target)) {
+      return subset(*found);
+    }
+    return std::nullopt;
+  }
+
+  // Answer find(target) for every element of targets, returned in the same
+  // order. With T distinct targets, L left sums and R right sums, one find
+  // per target costs O(T (L + R)). When there are more targets than left
+  // sums, the targets are instead merged with the right sums once per left
+  // sum, for O(L (T + R)): both lists are sorted, so the merge is one
+  // sequential pass over each, and targets drop out of later passes once
+  // they are matched.
+  std::vector<std::optional<std::vector<int>>>
+  find_all(const std::vector<int>& targets) const {
+    std::vector<int> distinct(targets);
+    std::sort(distinct.begin(), distinct.end());
+    distinct.erase(std::unique(distinct.begin(), distinct.end()), distinct.end());
+
+    std::vector<std::optional<std::pair<size_t, size_t>>> matches(distinct.size());
+    if (distinct.size() <= left_.size()) {
+      for (size_t k = 0; k < distinct.size(); ++k) {
+        matches[k] = match(distinct[k]);
+      }
+    } else {
+      std::vector<size_t> open(distinct.size());  // unmatched targets, ascending
+      std::iota(open.begin(), open.end(), 0);
+      for (size_t i = 0; i < left_.size() && !open.empty(); ++i) {
+        size_t j = 0, kept = 0;
+        for (size_t k : open) {
+          // j counts the right sums at most distinct[k] - left_[i].sum, so
+          // that j - 1 is the last of any run of equal sums, as in match
+          const int64_t wanted = distinct[k] - left_[i].sum;
+          while (j < right_.size() && right_[j].sum <= wanted) {
+            ++j;
+          }
+          if (j > 0 && right_[j - 1].sum == wanted) {
+            matches[k] = nonempty_match(i, j - 1);
+          }
+          if (!matches[k]) {
+            open[kept++] = k;
+          }
+        }
+        open.resize(kept);
+      }
+    }
+
+    std::vector<std::optional<std::vector<int>>> result;
+    result.reserve(targets.size());
+    for (int target : targets) {
+      size_t k = std::lower_bound(distinct.begin(), distinct.end(), target) - distinct.begin();
+      if (matches[k]) {
+        result.push_back(subset(*matches[k]));
+      } else {
+        result.push_back(std::nullopt);
+      }
+    }
+    return result;
+  }
+};
+
+// Count the non-empty subsets of input (distinguished by index, so equal
+// elements at different positions make different subsets) that add up to
+// exactly target. Meet in the middle: the sorted half sums are swept toward
+// each other as in subset_sum_index::find, and each pair of runs of equal
+// sums contributes the product of their lengths, so no subset is ever
+// materialized. Takes O(2^(n/2)) time and space. input must not be empty, and
+// must contain at most 62 elements.
+uint64_t subset_sum_count_mitm(const std::vector<int>& input, int target) {
+
+  assert(!input.empty());
+  assert(input.size() <= 62);
+
+  const size_t split = input.size() / 2;
+  const std::vector<half_sum> left = sorted_half_sums(input, 0, split),
+                              right = sorted_half_sums(input, split, input.size());
+  uint64_t count = 0;
+  size_t i = 0, j = right.size();
+  while (i < left.size() && j > 0) {
+    int64_t sum = left[i].sum + right[j - 1].sum;
+    if (sum < target) {
+      ++i;
+    } else if (sum > target) {
+      --j;
+    } else {
+      size_t left_end = i, right_begin = j;
+      while (left_end < left.size() && left[left_end].sum == left[i].sum) {
+        ++left_end;
+      }
+      while (right_begin > 0 && right[right_begin - 1].sum == right[j - 1].sum) {
+        --right_begin;
+      }
+      count += uint64_t(left_end - i) * (j - right_begin);
+      i = left_end;
+      j = right_begin;
+    }
+  }
+  // The empty subset was counted once if target is zero.
+  return (target == 0) ? count - 1 : count;
+}
+
+// Largest table of reachable sums subset_sum_count_dp will allocate, in
+// entries of 8 bytes each.
+constexpr size_t subset_sum_count_table_limit = size_t(1) << 26;
+
+// Count the same subsets as subset_sum_count_mitm by dynamic programming over
+// every reachable sum, in O(n * (P - N)) time and O(P - N) space, where P and
+// N are the sums of the positive and negative elements. This beats meet in
+// the middle when the elements are small, and has no limit on n.
+//
+// Throws std::length_error when P - N + 1 exceeds
+// subset_sum_count_table_limit, and std::overflow_error when the count does
+// not fit in a uint64_t. Counts are saturated rather than wrapped, so a
+// count of exactly 2^64 - 1 is also reported as an overflow.
+uint64_t subset_sum_count_dp(const std::vector<int>& input, int target) {
+
+  assert(!input.empty());
+
+  int64_t lowest = 0, highest = 0;
+  for (int x : input) {
+    (x < 0 ? lowest : highest) += x;
+  }
+  if (uint64_t(highest - lowest) >= subset_sum_count_table_limit) {
+    throw std::length_error("subset_sum_count_dp: range of reachable sums is too large");
+  }
+  if (target < lowest || target > highest) {
+    return 0;
+  }
+
+  // ways[s - lowest] is the number of subsets of the elements seen so far
+  // with sum s, including the empty subset, or saturated once it reaches
+  // the largest uint64_t.
+  constexpr uint64_t saturated = std::numeric_limits<uint64_t>::max();
+  auto add = [](uint64_t a, uint64_t b) {
+    uint64_t sum;
+    return __builtin_add_overflow(a, b, &sum) ? saturated : sum;
+  };
+  std::vector<uint64_t> ways(highest - lowest + 1, 0);
+  ways[-lowest] = 1;
+  for (int x : input) {
+    if (x > 0) {
+      for (size_t s = ways.size(); s-- > size_t(x); ) {
+        ways[s] = add(ways[s], ways[s - x]);
+      }
+    } else if (x < 0) {
+      const size_t shift = -int64_t(x);
+      for (size_t s = 0; s + shift < ways.size(); ++s) {
+        ways[s] = add(ways[s], ways[s + shift]);
+      }
+    } else {
+      for (uint64_t& w : ways) {
+        w = add(w, w);
+      }
+    }
+  }
+  uint64_t count = ways[target - lowest];
+  if (count == saturated) {
+    throw std::overflow_error("subset_sum_count_dp: count does not fit in 64 bits");
+  }
+  return (target == 0) ? count - 1 : count;
+}
+
+// Count the non-empty subsets of input that add up to exactly target, using
+// whichever of subset_sum_count_dp and subset_sum_count_mitm is expected to
+// be faster for this input: the table of reachable sums when it is no larger
+// than the 2^(n/2) half sums, and always when n exceeds 62. For n above 62,
+// throws the exceptions of subset_sum_count_dp when the range of sums is too
+// large or the count does not fit.
+uint64_t subset_sum_count(const std::vector<int>& input, int target) {
+
+  assert(!input.empty());
+
+  int64_t range = 1;
+  for (int x : input) {
+    range += std::abs(int64_t(x));
+  }
+  const size_t n = input.size();
+  if (n > 62 || double(range) <= std::ldexp(1.0, int(n / 2))) {
+    return subset_sum_count_dp(input, target);
+  }
+  return subset_sum_count_mitm(input, target);
+}
+
+// Lazily enumerates every non-empty subset of input that adds up to exactly
+// target, one per call to next(), without ever storing more than one
+// solution. Holds the two sorted half-sum arrays of subset_sum_index, so
+// memory is O(2^(n/2)) regardless of how many solutions there are; each call
+// does amortized O(1) work beyond building the returned vector, plus the
+// sweep over non-matching sums. Subsets are distinguished by index, so
+// exactly subset_sum_count(input, target) solutions are produced, each with
+// its elements in input order. input must not be empty, and must contain at
+// most 62 elements.
+class subset_sum_solutions {
+private:
+  std::vector<int> input_;
+  size_t split_;
+  int64_t target_;
+  std::vector<half_sum> left_, right_;
+
+  // Sweep position, as in subset_sum_index::find: left_[i_] and
+  // right_[j_ - 1] are the next sums to compare.
+  size_t i_, j_;
+
+  // While in_run_, the runs left_[i_, left_end_) and right_[right_begin_, j_)
+  // all add up to target, and (a_, b_) is the next pair to yield.
+  bool in_run_;
+  size_t left_end_, right_begin_, a_, b_;
+
+public:
+  subset_sum_solutions(const std::vector<int>& input, int target)
+  : input_(input), split_(input.size() / 2), target_(target),
+    in_run_(false), left_end_(0), right_begin_(0), a_(0), b_(0) {
+    assert(!input.empty());
+    assert(input.size() <= 62);
+    left_ = sorted_half_sums(input_, 0, split_);
+    right_ = sorted_half_sums(input_, split_, input_.size());
+    i_ = 0;
+    j_ = right_.size();
+  }
+
+  // Return the next solution, or an empty optional once every solution has
+  // been returned.
+  std::optional<std::vector<int>> next() {
+    while (true) {
+      if (in_run_) {
+        if (a_ < left_end_) {
+          uint64_t mask = left_[a_].mask | (uint64_t(right_[b_].mask) << split_);
+          if (++b_ == j_) {
+            b_ = right_begin_;
+            ++a_;
+          }
+          if (mask != 0) {
+            return subset_from_mask(input_, mask);
+          }
+          continue;
+        }
+        in_run_ = false;
+        i_ = left_end_;
+        j_ = right_begin_;
+      }
+
+      if (i_ >= left_.size() || j_ == 0) {
+        return std::nullopt;
+      }
+      int64_t sum = left_[i_].sum + right_[j_ - 1].sum;
+      if (sum < target_) {
+        ++i_;
+      } else if (sum > target_) {
+        --j_;
+      } else {
+        left_end_ = i_;
+        while (left_end_ < left_.size() && left_[left_end_].sum == left_[i_].sum) {
+          ++left_end_;
+        }
+        right_begin_ = j_;
+        while (right_begin_ > 0 && right_[right_begin_ - 1].sum == right_[j_ - 1].sum) {
+          --right_begin_;
+        }
+        a_ = i_;
+        b_ = right_begin_;
+        in_run_ = true;
+      }
+    }
+  }
+};
+
+// Solve the fixed-cardinality subset sum problem: return a subset of exactly
+// k elements of input that adds up to exactly target, or an empty optional if
+// there is none. Elements are returned in input order. input must not be
+// empty, and k must be at least 1.
+//
+// Only subsets of size k are examined. For k <= 4 the search joins sorted or
+// hashed smaller subsets: O(n) for k == 1, O(n log n) for k == 2, O(n^2) for
+// k == 3 and 4. Larger k enumerate all C(n, k) masks with Gosper's hack,
+// updating the sum only for the bits that change between consecutive masks;
+// this requires fewer than 64 elements.
+std::optional<std::vector<int>> subset_sum_k(const std::vector<int>& input, size_t k,
+                                             int target) {
+
+  assert(!input.empty());
+  assert(k >= 1);
+
+  const size_t n = input.size();
+  if (k > n) {
+    return std::nullopt;
+  }
+
+  auto subset_of = [&](std::vector<size_t> indices) {
+    std::sort(indices.begin(), indices.end());
+    std::vector<int> subset;
+    for (size_t index : indices) {
+      subset.push_back(input[index]);
+    }
+    return subset;
+  };
+
+  // Indices of input sorted by value, for the two-pointer joins.
+  std::vector<size_t> order(n);
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(),
+                   [&](size_t a, size_t b) { return input[a] < input[b]; });
+
+  // Search order[first, n) for two elements adding up to want.
+  auto two_pointer = [&](size_t first, int64_t want)
+    -> std::optional<std::pair<size_t, size_t>> {
+    if (first >= n) {
+      return std::nullopt;
+    }
+    size_t lo = first, hi = n - 1;
+    while (lo < hi) {
+      int64_t sum = int64_t(input[order[lo]]) + input[order[hi]];
+      if (sum < want) {
+        ++lo;
+      } else if (sum > want) {
+        --hi;
+      } else {
+        return std::make_pair(order[lo], order[hi]);
+      }
+    }
+    return std::nullopt;
+  };
+
+  switch (k) {
+  case 1:
+    for (size_t i = 0; i < n; ++i) {
+      if (input[i] == target) {
+        return std::vector<int>{input[i]};
+      }
+    }
+    return std::nullopt;
+
+  case 2:
+    if (auto pair = two_pointer(0, target)) {
+      return subset_of({pair->first, pair->second});
+    }
+    return std::nullopt;
+
+  case 3:
+    for (size_t i = 0; i + 2 < n; ++i) {
+      if (auto pair = two_pointer(i + 1, int64_t(target) - input[order[i]])) {
+        return subset_of({order[i], pair->first, pair->second});
+      }
+    }
+    return std::nullopt;
+
+  case 4: {
+    // Before visiting c, pairs holds one pair (a, b) with b < c for every
+    // pair sum seen so far; joining it with (c, d), d > c, keeps all four
+    // indices distinct.
+    std::unordered_map<int64_t, std::pair<size_t, size_t>> pairs;
+    for (size_t c = 0; c < n; ++c) {
+      for (size_t d = c + 1; d < n; ++d) {
+        auto found = pairs.find(int64_t(target) - input[c] - input[d]);
+        if (found != pairs.end()) {
+          return subset_of({found->second.first, found->second.second, c, d});
+        }
+      }
+      for (size_t a = 0; a < c; ++a) {
+        pairs.emplace(int64_t(input[a]) + input[c], std::make_pair(a, c));
+      }
+    }
+    return std::nullopt;
+  }
+
+  default: {
+    assert(n < 64);
+    uint64_t mask = (uint64_t(1) << k) - 1;
+    const uint64_t limit = uint64_t(1) << n;
+    int64_t sum = std::accumulate(input.begin(), input.begin() + k, int64_t(0));
+    while (true) {
+      if (sum == target) {
+        return subset_from_mask(input, mask);
+      }
+      // Gosper's hack: the next larger mask with the same number of bits.
+      uint64_t lowest = mask & -mask;
+      uint64_t ripple = mask + lowest;
+      if (ripple >= limit || ripple == 0) {
+        return std::nullopt;
+      }
+      uint64_t next = (((ripple ^ mask) >> 2) / lowest) | ripple;
+      for (uint64_t added = next & ~mask; added != 0; added &= added - 1) {
+        sum += input[__builtin_ctzll(added)];
+      }
+      for (uint64_t removed = mask & ~next; removed != 0; removed &= removed - 1) {
+        sum -= input[__builtin_ctzll(removed)];
+      }
+      mask = next;
+    }
+  }
+  }
+}
 
 }
@@ -0,0 +1,893 @@
+
+///////////////////////////////////////////////////////////////////////////////
+// poly_exp_engines_test.cpp
+//
+// Unit tests for the additional engines declared in poly_exp.hpp, beyond the
+// three required algorithms covered by poly_exp_test.cpp .
+///////////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <unistd.h>
+
+#include "gtest/gtest.h"
+
+#include "poly_exp.hpp"
+#include "poly_exp_service.hpp"
+
+std::vector<int> random_ints(size_t size, int min, int max, unsigned seed = 0) {
+  std::vector<int> result;
+  std::mt19937 rng(seed);
+  std::uniform_int_distribution<> randint(min, max);
+  for (size_t i = 0; i < size; ++i) {
+    result.push_back(randint(rng));
+  }
+  return result;
+}
+
+// Every subarray of input, sorted by decreasing sum, then begin, then end.
+std::vector<subarray::summed_span> all_subarrays_ranked(const std::vector<int>& input) {
+  std::vector<subarray::summed_span> all;
+  for (size_t b = 0; b < input.size(); ++b) {
+    for (size_t e = b + 1; e <= input.size(); ++e) {
+      all.emplace_back(input.begin() + b, input.begin() + e);
+    }
+  }
+  std::stable_sort(all.begin(), all.end(),
+                   [](const auto& x, const auto& y) { return x.sum() > y.sum(); });
+  return all;
+}
+
+TEST(max_subarrays_top_k, max_subarrays_top_k) {
+  { // k == 1 agrees with the exhaustive search
+    std::vector<int> clrs{
+      13, -3, -25, 20, -3, -16, -23, 18, 20, -7, 12, -5, -22, 15, -4, 7
+    };
+    auto result = subarray::max_subarrays_top_k(clrs, 1);
+    ASSERT_EQ(1, result.size());
+    EXPECT_EQ(subarray::max_subarray_exh(clrs), result[0]);
+    EXPECT_EQ(43, result[0].sum());
+  }
+
+  { // k larger than the number of subarrays returns all of them
+    std::vector<int> three{1, -2, 3};
+    EXPECT_EQ(6, subarray::max_subarrays_top_k(three, 100).size());
+  }
+
+  { // matches sorting every subarray, including tie order
+    for (unsigned seed = 0; seed < 20; ++seed) {
+      auto input = random_ints(40, -5, +5, seed);
+      auto expected = all_subarrays_ranked(input);
+      expected.resize(50, expected.front());
+      auto result = subarray::max_subarrays_top_k(input, 50);
+      ASSERT_EQ(expected.size(), result.size());
+      for (size_t i = 0; i < result.size(); ++i) {
+        EXPECT_EQ(expected[i], result[i]);
+        EXPECT_EQ(expected[i].sum(), result[i].sum());
+      }
+    }
+  }
+}
+
+TEST(max_subarrays_top_k_disjoint, max_subarrays_top_k_disjoint) {
+  { // two separated positive runs
+    std::vector<int> input{3, 4, -20, 5, -30, 1};
+    auto result = subarray::max_subarrays_top_k_disjoint(input, 3);
+    ASSERT_EQ(3, result.size());
+    EXPECT_EQ(subarray::summed_span(input.begin(), input.begin() + 2), result[0]);
+    EXPECT_EQ(subarray::summed_span(input.begin() + 3, input.begin() + 4), result[1]);
+    EXPECT_EQ(subarray::summed_span(input.begin() + 5, input.begin() + 6), result[2]);
+  }
+
+  { // runs out once every element is covered
+    std::vector<int> input{-1, -2, -3};
+    EXPECT_EQ(3, subarray::max_subarrays_top_k_disjoint(input, 10).size());
+  }
+
+  { // spans are disjoint, sums non-increasing, and the first is the maximum
+    auto input = random_ints(1000, -10, +10);
+    auto result = subarray::max_subarrays_top_k_disjoint(input, 25);
+    ASSERT_EQ(25, result.size());
+    EXPECT_EQ(subarray::max_subarray_dbh(input).sum(), result[0].sum());
+    std::vector<bool> used(input.size(), false);
+    for (size_t i = 0; i < result.size(); ++i) {
+      if (i > 0) {
+        EXPECT_GE(result[i - 1].sum(), result[i].sum());
+      }
+      for (auto it = result[i].begin(); it != result[i].end(); ++it) {
+        size_t index = it - input.cbegin();
+        EXPECT_FALSE(used[index]);
+        used[index] = true;
+      }
+    }
+  }
+}
+
+TEST(max_submatrix, max_submatrix) {
+  { // single element
+    EXPECT_EQ(-4, subarray::max_submatrix({-4}, 1, 1).sum);
+  }
+
+  { // one row matches the one-dimensional search
+    std::vector<int> clrs{
+      13, -3, -25, 20, -3, -16, -23, 18, 20, -7, 12, -5, -22, 15, -4, 7
+    };
+    auto result = subarray::max_submatrix(clrs, 1, clrs.size());
+    EXPECT_EQ((subarray::summed_rectangle{0, 7, 1, 11, 43}), result);
+    EXPECT_EQ(43, result.sum);
+  }
+
+  { // agrees with enumerating every rectangle, for any number of threads
+    const size_t rows = 9, cols = 11;
+    auto grid = random_ints(rows * cols, -10, +10);
+    subarray::summed_rectangle expected{0, 0, 1, 1, grid[0]};
+    for (size_t t = 0; t < rows; ++t) {
+      for (size_t l = 0; l < cols; ++l) {
+        for (size_t b = t + 1; b <= rows; ++b) {
+          for (size_t r = l + 1; r <= cols; ++r) {
+            int64_t sum = 0;
+            for (size_t i = t; i < b; ++i) {
+              for (size_t j = l; j < r; ++j) {
+                sum += grid[i * cols + j];
+              }
+            }
+            subarray::summed_rectangle candidate{t, l, b, r, sum};
+            if (candidate.ranks_before(expected)) {
+              expected = candidate;
+            }
+          }
+        }
+      }
+    }
+    for (unsigned threads = 1; threads <= 4; ++threads) {
+      auto result = subarray::max_submatrix(grid, rows, cols, threads);
+      EXPECT_EQ(expected, result);
+      EXPECT_EQ(expected.sum, result.sum);
+    }
+    for (auto level : cpu_dispatch::supported_levels()) {
+      cpu_dispatch::ScopedLevel scope(level);
+      EXPECT_EQ(expected, subarray::max_submatrix(grid, rows, cols, 2))
+        << cpu_dispatch::name(level);
+    }
+  }
+
+  { // every instruction set variant accumulates the same column sums
+    for (auto level : cpu_dispatch::supported_levels()) {
+      cpu_dispatch::ScopedLevel scope(level);
+      auto add_row = subarray::kernels::add_row();
+      for (size_t n = 0; n <= 40; ++n) {
+        auto row = random_ints(n, -1000000000, +1000000000, n);
+        std::vector<int64_t> expected(n, int64_t(1) << 40), sums = expected;
+        subarray::kernels::add_row_scalar(expected.data(), row.data(), n);
+        add_row(sums.data(), row.data(), n);
+        EXPECT_EQ(expected, sums) << cpu_dispatch::name(level) << ", n=" << n;
+      }
+    }
+  }
+}
+
+// Lowest (begin, end) maximum-sum subarray with size in [lo, hi], by brute
+// force.
+subarray::summed_span length_bounded_brute(const std::vector<int>& input,
+                                           size_t lo, size_t hi) {
+  std::optional<subarray::summed_span> best;
+  for (size_t b = 0; b < input.size(); ++b) {
+    for (size_t e = b + lo; e <= std::min(input.size(), b + hi); ++e) {
+      subarray::summed_span candidate(input.begin() + b, input.begin() + e);
+      if (!best || candidate.sum() > best->sum()) {
+        best = candidate;
+      }
+    }
+  }
+  return *best;
+}
+
+TEST(max_subarray_length_bounded, max_subarray_length_bounded) {
+  { // unconstrained lengths agree with the exhaustive search
+    std::vector<int> clrs{
+      13, -3, -25, 20, -3, -16, -23, 18, 20, -7, 12, -5, -22, 15, -4, 7
+    };
+    EXPECT_EQ(subarray::max_subarray_exh(clrs),
+              subarray::max_subarray_length_bounded(clrs, 1, clrs.size()));
+  }
+
+  { // forced to include a negative element
+    std::vector<int> input{5, -1, 5, -100};
+    auto result = subarray::max_subarray_length_bounded(input, 1, 1);
+    EXPECT_EQ(subarray::summed_span(input.begin(), input.begin() + 1), result);
+    result = subarray::max_subarray_length_bounded(input, 4, 4);
+    EXPECT_EQ(-91, result.sum());
+  }
+
+  { // random instances, single and batch entry points agree with brute force
+    auto input = random_ints(200, -10, +10);
+    std::vector<std::pair<size_t, size_t>> bounds{
+      {1, 1}, {1, 5}, {3, 3}, {10, 20}, {50, 500}, {200, 200}
+    };
+    auto batch = subarray::max_subarrays_length_bounded(input, bounds);
+    ASSERT_EQ(bounds.size(), batch.size());
+    for (size_t i = 0; i < bounds.size(); ++i) {
+      auto [lo, hi] = bounds[i];
+      auto expected = length_bounded_brute(input, lo, hi);
+      EXPECT_EQ(expected, batch[i]);
+      EXPECT_EQ(expected.sum(), batch[i].sum());
+      EXPECT_EQ(expected, subarray::max_subarray_length_bounded(input, lo, hi));
+    }
+  }
+}
+
+TEST(max_subarray_batch, max_subarray_batch) {
+  { // a partial block of arrays with different lengths
+    std::vector<std::vector<int>> arrays{{1}, {-1, 2}, {1, 2, -9, 2, 2}, {-2, -2, -2}};
+    auto result = subarray::max_subarray_batch(subarray::interleaved_arrays(arrays));
+    EXPECT_EQ((std::vector<uint32_t>{0, 1, 3, 0}), result.begins);
+    EXPECT_EQ((std::vector<uint32_t>{1, 2, 5, 1}), result.ends);
+    EXPECT_EQ((std::vector<int>{1, 2, 4, -2}), result.sums);
+  }
+
+  { // full blocks plus leftovers agree with the exhaustive search
+    std::mt19937 rng(0);
+    std::uniform_int_distribution<> randlength(1, 64);
+    std::vector<std::vector<int>> arrays;
+    for (unsigned i = 0; i < 77; ++i) {
+      arrays.push_back(random_ints(randlength(rng), -10, +10, i));
+    }
+    for (auto level : cpu_dispatch::supported_levels()) {
+      cpu_dispatch::ScopedLevel scope(level);
+      auto result = subarray::max_subarray_batch(subarray::interleaved_arrays(arrays));
+      for (size_t i = 0; i < arrays.size(); ++i) {
+        auto expected = subarray::max_subarray_exh(arrays[i]);
+        EXPECT_EQ(expected.begin() - arrays[i].cbegin(), result.begins[i])
+          << cpu_dispatch::name(level) << ", array " << i;
+        EXPECT_EQ(expected.end() - arrays[i].cbegin(), result.ends[i])
+          << cpu_dispatch::name(level) << ", array " << i;
+        EXPECT_EQ(expected.sum(), result.sums[i]) << cpu_dispatch::name(level) << ", array " << i;
+      }
+    }
+  }
+}
+
+TEST(max_subarray_exh_quadratic, max_subarray_exh_quadratic) {
+  { // ties resolve exactly as in the cubic search
+    std::vector<int> zeroes{0, 0, 0}, tied{1, 1, -2, 3}, negative{-2, -2, -2};
+    for (auto* input : {&zeroes, &tied, &negative}) {
+      auto expected = subarray::max_subarray_exh(*input);
+      for (unsigned threads = 1; threads <= 4; ++threads) {
+        EXPECT_EQ(expected, subarray::max_subarray_exh_quadratic(*input, threads));
+      }
+    }
+  }
+
+  { // random instance from poly_exp_test.cpp
+    auto medium = random_ints(1000, -10, +10);
+    auto expected = subarray::max_subarray_exh(medium);
+    for (unsigned threads = 1; threads <= 4; ++threads) {
+      auto result = subarray::max_subarray_exh_quadratic(medium, threads);
+      EXPECT_EQ(expected, result);
+      EXPECT_EQ(expected.sum(), result.sum());
+    }
+  }
+
+  { // every instruction set variant finds the first maximum
+    for (auto level : cpu_dispatch::supported_levels()) {
+      cpu_dispatch::ScopedLevel scope(level);
+      auto first_max = subarray::kernels::first_max();
+      for (size_t n = 1; n <= 40; ++n) {
+        auto ints = random_ints(n, -3, +3, n);
+        std::vector<int64_t> values(ints.begin(), ints.end());
+        EXPECT_EQ(subarray::kernels::first_max_scalar(values.data(), n),
+                  first_max(values.data(), n)) << cpu_dispatch::name(level) << ", n=" << n;
+      }
+      auto medium = random_ints(300, -10, +10);
+      EXPECT_EQ(subarray::max_subarray_exh(medium), subarray::max_subarray_exh_quadratic(medium, 2))
+        << cpu_dispatch::name(level);
+    }
+  }
+}
+
+// Call visit(mask, sum) for every non-empty subset of input, by brute force.
+template <typename Visit>
+void for_each_subset(const std::vector<int>& input, Visit visit) {
+  for (uint64_t mask = 1; mask < (uint64_t(1) << input.size()); ++mask) {
+    int64_t sum = 0;
+    for (size_t j = 0; j < input.size(); ++j) {
+      if ((mask >> j) & 1) {
+        sum += input[j];
+      }
+    }
+    visit(mask, sum);
+  }
+}
+
+// Number of non-empty subsets of input adding up to target, by brute force.
+uint64_t count_subset_sums(const std::vector<int>& input, int64_t target) {
+  uint64_t count = 0;
+  for_each_subset(input, [&](uint64_t, int64_t sum) { count += (sum == target); });
+  return count;
+}
+
+// Whether some non-empty subset of input adds up to target, by brute force.
+bool has_subset_sum(const std::vector<int>& input, int64_t target) {
+  return count_subset_sums(input, target) > 0;
+}
+
+// Whether some subset of exactly k elements of input adds up to target, by
+// brute force.
+bool has_k_subset_sum(const std::vector<int>& input, size_t k, int64_t target) {
+  bool found = false;
+  for_each_subset(input, [&](uint64_t mask, int64_t sum) {
+    found |= (sum == target) && (size_t(__builtin_popcountll(mask)) == k);
+  });
+  return found;
+}
+
+TEST(subset_sum_index, subset_sum_index) {
+  { // same small cases as subset_sum_exh
+    EXPECT_FALSE(subarray::subset_sum_index({5}).find(1));
+    EXPECT_EQ((std::vector<int>{5}), subarray::subset_sum_index({5}).find(5));
+    EXPECT_EQ((std::vector<int>{1, 3}), subarray::subset_sum_index({1, 3}).find(4));
+    EXPECT_FALSE(subarray::subset_sum_index({1, 2, 3}).find(0));
+    EXPECT_FALSE(subarray::subset_sum_index({8, 2, -5, 3}).find(1));
+    EXPECT_TRUE(subarray::subset_sum_index({-7, -3, -2, 5, 8}).find(0));
+  }
+
+  { // zero target needs a non-empty subset, found through duplicate sums
+    EXPECT_EQ((std::vector<int>{0}), subarray::subset_sum_index({0, 4}).find(0));
+    EXPECT_EQ((std::vector<int>{0}), subarray::subset_sum_index({4, 0}).find(0));
+  }
+
+  { // CLRS page 1097
+    std::vector<int> input{
+      1, 2, 7, 14, 49, 98, 343, 686, 2409, 2793, 16808, 17206, 117705, 117993
+    };
+    auto result = subarray::subset_sum_index(input).find(138457);
+    ASSERT_TRUE(result.has_value());
+    EXPECT_TRUE(subarray::is_subset_sum_solution(input, *result, 138457));
+  }
+
+  { // random instances, find and find_all agree with brute force
+    for (unsigned seed = 0; seed < 10; ++seed) {
+      auto input = random_ints(1 + seed, -20, +20, seed);
+      subarray::subset_sum_index index(input);
+      std::vector<int> targets;
+      for (int target = -60; target <= 60; target += 3) {
+        targets.push_back(target);
+      }
+      targets.push_back(0);
+      auto all = index.find_all(targets);
+      ASSERT_EQ(targets.size(), all.size());
+      for (size_t i = 0; i < targets.size(); ++i) {
+        bool expected = has_subset_sum(input, targets[i]);
+        auto single = index.find(targets[i]);
+        EXPECT_EQ(expected, single.has_value());
+        EXPECT_EQ(expected, all[i].has_value());
+        if (single) {
+          EXPECT_TRUE(subarray::is_subset_sum_solution(input, *single, targets[i]));
+        }
+        if (all[i]) {
+          EXPECT_TRUE(subarray::is_subset_sum_solution(input, *all[i], targets[i]));
+        }
+      }
+    }
+  }
+
+  { // many targets, both more and fewer than the left sums
+    for (size_t n : {6, 12, 20}) {
+      auto input = random_ints(n, -40, +40, unsigned(n));
+      std::set<int64_t> sums;
+      for_each_subset(input, [&](uint64_t, int64_t sum) { sums.insert(sum); });
+      std::vector<int> targets;
+      for (int target = -400; target <= 400; ++target) {
+        targets.push_back(target);
+      }
+      targets.push_back(7);
+      auto all = subarray::subset_sum_index(input).find_all(targets);
+      ASSERT_EQ(targets.size(), all.size());
+      for (size_t i = 0; i < targets.size(); ++i) {
+        EXPECT_EQ(sums.count(targets[i]) > 0, all[i].has_value())
+          << "n=" << n << ", target=" << targets[i];
+        if (all[i]) {
+          EXPECT_TRUE(subarray::is_subset_sum_solution(input, *all[i], targets[i]));
+        }
+      }
+    }
+  }
+}
+
+TEST(subset_sum_bnb, subset_sum_bnb) {
+  { // same small cases as subset_sum_exh
+    EXPECT_FALSE(subarray::subset_sum_bnb({5}, 1));
+    EXPECT_EQ((std::vector<int>{5}), subarray::subset_sum_bnb({5}, 5));
+    EXPECT_EQ((std::vector<int>{1, 3}), subarray::subset_sum_bnb({1, 3}, 4));
+    EXPECT_EQ((std::vector<int>{5, -2}), subarray::subset_sum_bnb({5, -2}, 3));
+    EXPECT_FALSE(subarray::subset_sum_bnb({1, 2, 3}, 0));
+    EXPECT_FALSE(subarray::subset_sum_bnb({2, 4, 6}, 5));
+    EXPECT_FALSE(subarray::subset_sum_bnb({8, 2, -5, 3}, 1));
+    EXPECT_TRUE(subarray::subset_sum_bnb({-7, -3, -2, 5, 8}, 0));
+    EXPECT_EQ((std::vector<int>{0}), subarray::subset_sum_bnb({0, 4}, 0));
+  }
+
+  { // sums beyond an int do not wrap around to the target
+    const int big = std::numeric_limits<int>::max();
+    EXPECT_FALSE(subarray::subset_sum_exh({big, big, 2}, 0));
+    EXPECT_FALSE(subarray::subset_sum_bnb({big, big, 2}, 0));
+  }
+
+  { // random instances with duplicates agree with brute force
+    for (unsigned seed = 0; seed < 12; ++seed) {
+      auto input = random_ints(1 + seed, -5, +15, seed);
+      for (int target = -20; target <= 60; ++target) {
+        auto result = subarray::subset_sum_bnb(input, target);
+        EXPECT_EQ(has_subset_sum(input, target), result.has_value());
+        if (result) {
+          EXPECT_TRUE(subarray::is_subset_sum_solution(input, *result, target));
+        }
+      }
+    }
+  }
+
+  { // far beyond the exhaustive limit on positive input with no solution
+    std::vector<int> input;
+    for (int i = 0; i < 100; ++i) {
+      input.push_back(2 * (i + 1));
+    }
+    EXPECT_FALSE(subarray::subset_sum_bnb(input, 10001));
+    auto result = subarray::subset_sum_bnb(input, 10000);
+    ASSERT_TRUE(result.has_value());
+    EXPECT_TRUE(subarray::is_subset_sum_solution(input, *result, 10000));
+  }
+
+  { // long all-equal inputs, far deeper than the call stack could search
+    std::vector<int> ones(200000, 1);
+    auto result = subarray::subset_sum_bnb(ones, 200000);
+    ASSERT_TRUE(result.has_value());
+    EXPECT_EQ(ones, *result);
+    std::vector<int> twos(200000, 2);
+    EXPECT_FALSE(subarray::subset_sum_bnb(twos, 200001));
+    EXPECT_EQ(std::vector<int>(1000, 2), subarray::subset_sum_bnb(twos, 2000));
+  }
+}
+
+TEST(subset_sum_count, subset_sum_count) {
+  { // small cases, including zeroes and the excluded empty subset
+    EXPECT_EQ(0, subarray::subset_sum_count({1, 2, 3}, 0));
+    EXPECT_EQ(2, subarray::subset_sum_count({1, 2, 3}, 3));
+    EXPECT_EQ(3, subarray::subset_sum_count({0, 0}, 0));
+    EXPECT_EQ(4, subarray::subset_sum_count({0, 0, 5}, 5));
+  }
+
+  { // both strategies agree with brute force
+    for (unsigned seed = 0; seed < 12; ++seed) {
+      auto input = random_ints(1 + seed, -6, +6, seed);
+      for (int target = -30; target <= 30; ++target) {
+        uint64_t expected = count_subset_sums(input, target);
+        EXPECT_EQ(expected, subarray::subset_sum_count_mitm(input, target));
+        EXPECT_EQ(expected, subarray::subset_sum_count_dp(input, target));
+        EXPECT_EQ(expected, subarray::subset_sum_count(input, target));
+      }
+    }
+  }
+
+  { // dynamic programming handles n beyond 62 when values are small
+    std::vector<int> ones(63, 1);
+    EXPECT_EQ(63, subarray::subset_sum_count(ones, 1));
+    EXPECT_EQ(63 * 62 / 2, subarray::subset_sum_count(ones, 2));
+  }
+
+  { // too many sums to tabulate, or too many subsets to count
+    std::vector<int> large(63, std::numeric_limits<int>::max() - 63);
+    EXPECT_THROW(subarray::subset_sum_count(large, 5), std::length_error);
+    std::vector<int> zeroes(64, 0);
+    EXPECT_THROW(subarray::subset_sum_count(zeroes, 0), std::overflow_error);
+    zeroes.pop_back();
+    EXPECT_EQ(std::numeric_limits<uint64_t>::max() >> 1, subarray::subset_sum_count(zeroes, 0));
+  }
+}
+
+TEST(subset_sum_solutions, subset_sum_solutions) {
+  { // no solutions
+    subarray::subset_sum_solutions solutions({1, 2, 3}, 0);
+    EXPECT_FALSE(solutions.next());
+    EXPECT_FALSE(solutions.next());
+  }
+
+  { // yields exactly the counted solutions, each distinct and valid
+    for (unsigned seed = 0; seed < 12; ++seed) {
+      auto input = random_ints(1 + seed, -6, +6, seed);
+      for (int target : {-5, 0, 3}) {
+        subarray::subset_sum_solutions solutions(input, target);
+        uint64_t yielded = 0;
+        while (auto solution = solutions.next()) {
+          EXPECT_TRUE(subarray::is_subset_sum_solution(input, *solution, target));
+          ++yielded;
+        }
+        EXPECT_EQ(count_subset_sums(input, target), yielded);
+      }
+    }
+  }
+}
+
+TEST(subset_sum_k, subset_sum_k) {
+  { // small cases
+    EXPECT_EQ((std::vector<int>{5}), subarray::subset_sum_k({5}, 1, 5));
+    EXPECT_FALSE(subarray::subset_sum_k({5}, 2, 5));
+    EXPECT_EQ((std::vector<int>{1, 3}), subarray::subset_sum_k({1, 3, 2}, 2, 4));
+    EXPECT_FALSE(subarray::subset_sum_k({2, 2, 4}, 2, 4 + 4));
+    EXPECT_EQ((std::vector<int>{3, 1, 2, 4}), subarray::subset_sum_k({3, 1, 2, 4}, 4, 10));
+  }
+
+  { // every k agrees with brute force
+    for (unsigned seed = 0; seed < 6; ++seed) {
+      auto input = random_ints(7 + seed, -8, +8, seed);
+      for (size_t k = 1; k <= input.size(); ++k) {
+        for (int target = -25; target <= 25; ++target) {
+          auto result = subarray::subset_sum_k(input, k, target);
+          EXPECT_EQ(has_k_subset_sum(input, k, target), result.has_value());
+          if (result) {
+            EXPECT_EQ(k, result->size());
+            EXPECT_TRUE(subarray::is_subset_sum_solution(input, *result, target));
+          }
+        }
+      }
+    }
+  }
+}
+
+TEST(subset_sum_exh_resumable, subset_sum_exh_resumable) {
+  { // same answers as subset_sum_exh without a checkpoint
+    EXPECT_FALSE(subarray::subset_sum_exh_resumable({1, 2, 3}, 0).subset);
+    EXPECT_FALSE(subarray::subset_sum_exh_resumable({8, 2, -5, 3}, 1).subset);
+    auto result = subarray::subset_sum_exh_resumable({-7, -3, -2, 5, 8}, 0);
+    EXPECT_TRUE(result.finished);
+    ASSERT_TRUE(result.subset);
+    EXPECT_TRUE(subarray::is_subset_sum_solution({-7, -3, -2, 5, 8}, *result.subset, 0));
+  }
+
+  { // stop, then resume from the checkpoint until the search finishes
+    std::vector<int> input;
+    for (int i = 0; i < 22; ++i) {
+      input.push_back(2 * (i + 1));
+    }
+    const std::string path = "subset_sum_exh_resumable_test.checkpoint";
+    std::remove(path.c_str());
+
+    std::atomic<bool> stop(false);
+    subarray::exh_resumable_options options;
+    options.checkpoint_path = path;
+    options.threads = 3;
+    options.checkpoint_interval = std::chrono::milliseconds(1);
+    options.masks_per_slice = 1024;
+    options.stop = &stop;
+    options.on_progress = [&](const subarray::exh_progress& progress) {
+      EXPECT_LE(progress.masks_done, progress.masks_total);
+      stop = true;
+    };
+    auto first = subarray::subset_sum_exh_resumable(input, 1, options);
+    ASSERT_FALSE(first.finished);
+    EXPECT_FALSE(first.subset);
+    ASSERT_TRUE(std::ifstream(path).good());
+
+    uint64_t resumed_from = 0;
+    stop = false;
+    options.threads = 1;
+    options.on_progress = [&](const subarray::exh_progress& progress) {
+      if (resumed_from == 0) {
+        resumed_from = progress.masks_done;
+      }
+    };
+    auto second = subarray::subset_sum_exh_resumable(input, 1, options);
+    EXPECT_TRUE(second.finished);
+    EXPECT_FALSE(second.subset);
+    EXPECT_GT(resumed_from, 0);
+    EXPECT_FALSE(std::ifstream(path).good());
+  }
+}
+
+TEST(fixed_size_kernels, fixed_size_kernels) {
+  { // usable in constant expressions
+    constexpr std::array<int, 5> five{1, 2, -9, 2, 2};
+    static_assert(subarray::max_subarray_dbh(five) == subarray::offset_summed_span32(3, 5, 4));
+    static_assert(subarray::max_subarray_dbh(five).sum() == 4);
+    constexpr std::array<int, 4> four{8, 2, -5, 3};
+    static_assert(!subarray::subset_sum_exh(four, 1));
+    static_assert(subarray::subset_sum_exh(four, 6)->size == 3);
+  }
+
+  { // dispatchers agree with the generic algorithms for every routed size
+    for (size_t n = 1; n <= subarray::max_subarray_fixed_limit + 2; ++n) {
+      auto input = random_ints(n, -10, +10, n);
+      auto expected = subarray::max_subarray_dbh(input);
+      auto result = subarray::max_subarray_dbh_auto(input);
+      EXPECT_EQ(expected, result);
+      EXPECT_EQ(expected.sum(), result.sum());
+    }
+    for (size_t n = 1; n <= subarray::subset_sum_fixed_limit + 2; ++n) {
+      auto input = random_ints(n, -50, +50, n);
+      for (int target : {-7, 0, 13}) {
+        auto expected = subarray::subset_sum_exh(input, target);
+        auto result = subarray::subset_sum_exh_auto(input, target);
+        EXPECT_EQ(expected.has_value(), result.has_value());
+        if (result) {
+          EXPECT_TRUE(subarray::is_subset_sum_solution(input, *result, target));
+        }
+      }
+    }
+  }
+}
+
+TEST(offset_summed_span, offset_summed_span) {
+  { // round trip through offsets
+    std::vector<int> clrs{
+      13, -3, -25, 20, -3, -16, -23, 18, 20, -7, 12, -5, -22, 15, -4, 7
+    };
+    auto best = subarray::max_subarray_exh(clrs);
+    subarray::offset_summed_span32 compact(best, clrs);
+    EXPECT_EQ(7, compact.begin());
+    EXPECT_EQ(11, compact.end());
+    EXPECT_EQ(4, compact.size());
+    EXPECT_EQ(43, compact.sum());
+    EXPECT_EQ(best, compact.to_summed_span(clrs));
+
+    // the offsets stay valid for a copy of the input
+    std::vector<int> copy(clrs);
+    EXPECT_EQ(best.sum(), compact.to_summed_span(copy).sum());
+  }
+
+  { // top-k results stored densely and copied as raw bytes
+    auto input = random_ints(100, -10, +10);
+    auto top = subarray::max_subarrays_top_k(input, 10);
+    auto compact = subarray::to_offset_spans(top, input);
+    std::vector<subarray::offset_summed_span32> copied(compact.size());
+    std::memcpy(copied.data(), compact.data(), compact.size() * sizeof(compact[0]));
+    ASSERT_EQ(top.size(), copied.size());
+    for (size_t i = 0; i < top.size(); ++i) {
+      EXPECT_EQ(top[i], copied[i].to_summed_span(input));
+      EXPECT_EQ(top[i].sum(), copied[i].sum());
+    }
+  }
+
+  { // batch results as compact spans
+    std::vector<std::vector<int>> arrays{{1, 2, -9, 2, 2}, {-1, 2}};
+    auto result = subarray::max_subarray_batch(subarray::interleaved_arrays(arrays));
+    EXPECT_EQ(subarray::offset_summed_span32(3, 5, 4), result.at(0));
+    EXPECT_EQ(subarray::offset_summed_span32(1, 2, 2), result.at(1));
+  }
+}
+
+TEST(poly_exp_service, poly_exp_service) {
+  const std::string path = "/tmp/poly_exp_engines_test." + std::to_string(getpid()) + ".sock";
+  service::Server server(path, 2);
+  poly_exp_service::register_operations(server);
+  server.start();
+  service::Client client(path);
+
+  auto input = random_ints(100, -10, +10);
+  const std::string request(reinterpret_cast<const char*>(input.data()),
+                            input.size() * sizeof(int));
+
+  { // both subarray operations, pipelined
+    uint64_t dbh = client.send(poly_exp_service::max_subarray, request),
+             exh = client.send(poly_exp_service::max_subarray_exh, request);
+    for (size_t i = 0; i < 2; ++i) {
+      auto [id, status, response] = client.receive();
+      ASSERT_EQ(service::status_ok, status);
+      service::PayloadReader in(response);
+      uint64_t begin, end;
+      int64_t sum;
+      ASSERT_TRUE(in.read(begin) && in.read(end) && in.read(sum));
+      auto expected = (id == dbh) ? subarray::max_subarray_dbh_auto(input)
+                                  : subarray::max_subarray_exh(input);
+      EXPECT_TRUE(id == dbh || id == exh);
+      EXPECT_EQ(expected.begin() - input.begin(), begin);
+      EXPECT_EQ(expected.end() - input.begin(), end);
+      EXPECT_EQ(expected.sum(), sum);
+    }
+  }
+
+  { // subset sum, with and without a solution
+    std::vector<int> values{3, 34, 4, 12, 5, 2};
+    for (int32_t target : {9, 100}) {
+      std::string payload(reinterpret_cast<const char*>(&target), sizeof(target));
+      payload.append(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(int));
+      auto [status, response] = client.call(poly_exp_service::subset_sum, payload);
+      ASSERT_EQ(service::status_ok, status);
+      service::PayloadReader in(response);
+      uint8_t found;
+      std::vector<int> subset;
+      ASSERT_TRUE(in.read(found) && in.read_rest(subset));
+      EXPECT_EQ(target == 9, bool(found));
+      EXPECT_EQ(found ? target : 0, std::accumulate(subset.begin(), subset.end(), 0));
+    }
+  }
+
+  { // empty input is rejected, and stats report every operation
+    EXPECT_EQ(service::status_bad_request,
+              client.call(poly_exp_service::max_subarray, "").first);
+    auto [status, report] = client.call(service::stats_operation, "");
+    ASSERT_EQ(service::status_ok, status);
+    EXPECT_NE(std::string::npos, report.find("max_subarray_exh: count=1"));
+    EXPECT_NE(std::string::npos, report.find("subset_sum: count=2"));
+  }
+
+  { // subset sum without input, or with more than the limit, is rejected
+    auto as_bytes = [](const std::vector<int>& ints) {
+      return std::string(reinterpret_cast<const char*>(ints.data()), ints.size() * sizeof(int));
+    };
+    EXPECT_EQ(service::status_bad_request,
+              client.call(poly_exp_service::subset_sum, as_bytes({5})).first);
+    // the target, then one more element than the limit
+    std::vector<int> oversized(poly_exp_service::subset_sum_limit + 2, 1);
+    oversized[0] = int(poly_exp_service::subset_sum_limit);
+    EXPECT_EQ(service::status_bad_request,
+              client.call(poly_exp_service::subset_sum, as_bytes(oversized)).first);
+    oversized.pop_back();
+    auto [status, response] = client.call(poly_exp_service::subset_sum, as_bytes(oversized));
+    EXPECT_EQ(service::status_ok, status);
+    EXPECT_EQ(1 + poly_exp_service::subset_sum_limit * sizeof(int), response.size());
+
+    std::vector<int> long_input(poly_exp_service::max_subarray_exh_limit + 1, 1);
+    EXPECT_EQ(service::status_bad_request,
+              client.call(poly_exp_service::max_subarray_exh, as_bytes(long_input)).first);
+    EXPECT_EQ(service::status_ok,
+              client.call(poly_exp_service::max_subarray, as_bytes(long_input)).first);
+  }
+
+  { // the readers of closed connections are reaped as new ones arrive
+    for (int i = 0; i < 50; ++i) {
+      service::Client brief(path);
+      EXPECT_EQ(service::status_ok, brief.call(service::stats_operation, "").first);
+    }
+    EXPECT_LT(server.readers(), 10u);
+  }
+
+  { // payloads over the limits are refused, and the connection stays usable
+    service::Server small(path + ".small", 1, 64);
+    poly_exp_service::register_operations(small);
+    small.start();
+    service::Client limited(path + ".small");
+    EXPECT_EQ(service::status_bad_request,
+              limited.call(poly_exp_service::max_subarray, request).first);
+    std::vector<int> few{-1, 2, -3};
+    auto [status, response] = limited.call(
+      poly_exp_service::max_subarray,
+      std::string_view(reinterpret_cast<const char*>(few.data()), few.size() * sizeof(int)));
+    EXPECT_EQ(service::status_ok, status);
+    EXPECT_EQ(3 * sizeof(uint64_t), response.size());
+
+    service::Client tiny(path + ".small", 8);
+    EXPECT_THROW(tiny.call(service::stats_operation, ""), std::system_error);
+    small.stop();
+  }
+
+  server.stop();
+}
+
+TEST(subset_sum_exh_memo, subset_sum_exh_memo) {
+  { // the target is part of the key
+    subarray::subset_sum_cache cache(10);
+    std::vector<int> input{3, 34, 4, 12, 5, 2};
+    for (size_t round = 0; round < 2; ++round) {
+      for (int target : {9, 100, 39}) {
+        EXPECT_EQ(subarray::subset_sum_exh(input, target),
+                  subarray::subset_sum_exh_memo(input, target, cache));
+      }
+    }
+    EXPECT_EQ(3, cache.stats().misses);
+    EXPECT_EQ(3, cache.stats().memory_hits);
+  }
+
+  { // results too large for a disk slot stay in memory only
+    const std::string path = "/tmp/poly_exp_engines_test." + std::to_string(getpid()) + ".cache";
+    auto input = random_ints(12, -50, +50);
+    auto expected = subarray::subset_sum_exh(input, 0);
+    {
+      subarray::subset_sum_cache cache(10, path, 16, 8);
+      subarray::subset_sum_exh_memo(input, 0, cache);
+    }
+    {
+      subarray::subset_sum_cache cache(10, path, 16, 256);
+      EXPECT_EQ(expected, subarray::subset_sum_exh_memo(input, 0, cache));
+      EXPECT_EQ(0, cache.stats().disk_hits);
+    }
+    subarray::subset_sum_cache cache(10, path, 16, 256);
+    EXPECT_EQ(expected, subarray::subset_sum_exh_memo(input, 0, cache));
+    EXPECT_EQ(1, cache.stats().disk_hits);
+
+    // while the file is open, a cache with another layout leaves it alone
+    subarray::subset_sum_cache other(10, path, 32, 256);
+    EXPECT_FALSE(other.has_disk_tier());
+    subarray::subset_sum_cache same(10, path, 16, 256);
+    ASSERT_TRUE(same.has_disk_tier());
+    EXPECT_EQ(expected, subarray::subset_sum_exh_memo(input, 0, same));
+    EXPECT_EQ(1, same.stats().disk_hits);
+    unlink(path.c_str());
+  }
+}
+
+TEST(max_subarray_parallel, huge_buffer) {
+  { // agrees with the exhaustive search, ties included, for any partitioning
+    for (unsigned seed = 0; seed < 20; ++seed) {
+      auto input = random_ints(1 + seed * 3, -3, +3, seed);
+      auto expected = subarray::max_subarray_exh(input);
+      for (unsigned threads = 1; threads <= 5; ++threads) {
+        auto result = subarray::max_subarray_parallel(input, threads);
+        EXPECT_EQ(expected, result) << "seed=" << seed << ", threads=" << threads;
+        EXPECT_EQ(expected.sum(), result.sum());
+      }
+    }
+  }
+
+  { // huge-page buffer initialized by first touch
+    const size_t n = 3 * 1000 * 1000;
+    HugeBuffer<int> buffer(n, 4, [](size_t i) { return (i % 2) ? -1 : 1; });
+    EXPECT_EQ(0, reinterpret_cast<uintptr_t>(buffer.data()) % HugeBuffer<int>::huge_page_bytes);
+    buffer[2000000] = 50;
+    auto best = subarray::max_subarray_parallel(buffer.data(), n, 4);
+    // the alternating prefix adds nothing, so the earliest-beginning tie wins
+    EXPECT_EQ(50, best.sum());
+    EXPECT_EQ(0, best.begin());
+    EXPECT_EQ(2000001, best.end());
+  }
+
+  { // sums too large for an int
+    const int big = std::numeric_limits<int>::max();
+    std::vector<int> input{-1, big, big, -2, big, -big, 1};
+    for (unsigned threads = 1; threads <= 4; ++threads) {
+      auto best = subarray::max_subarray_parallel(input.data(), input.size(), threads);
+      EXPECT_EQ(3 * int64_t(big) - 2, best.sum());
+      EXPECT_EQ(1, best.begin());
+      EXPECT_EQ(5, best.end());
+    }
+  }
+}
+
+TEST(max_subarray_dbh, halving_blocks) {
+  { // elements far below zero
+    std::vector<int> low{-5000, -2000, -3000};
+    auto best = subarray::max_subarray_dbh(low);
+    EXPECT_EQ(low.begin() + 1, best.begin());
+    EXPECT_EQ(low.begin() + 2, best.end());
+    EXPECT_EQ(-2000, best.sum());
+  }
+
+  { // same sums as the exhaustive search for large magnitudes
+    for (unsigned seed = 0; seed < 20; ++seed) {
+      auto input = random_ints(50, -1000000, +1000, seed);
+      EXPECT_EQ(subarray::max_subarray_exh(input).sum(),
+                subarray::max_subarray_dbh(input).sum()) << "seed=" << seed;
+    }
+  }
+
+  { // the same ties as the rescanning recursion, within and across blocks
+    for (size_t n = 1; n <= 300; n += (n < 70) ? 1 : 23) {
+      for (unsigned seed = 0; seed < 5; ++seed) {
+        auto input = random_ints(n, -1, +1, seed);
+        auto expected = subarray::max_subarray_dbh_rescan(input);
+        auto result = subarray::max_subarray_dbh(input);
+        EXPECT_EQ(expected, result) << "n=" << n << ", seed=" << seed;
+        EXPECT_EQ(expected.sum(), result.sum());
+      }
+    }
+  }
+
+  { // a long input, split into many blocks
+    std::vector<int> long_input(5 * 1000 * 1000, -1);
+    long_input[4000000] = 3;
+    auto best = subarray::max_subarray_dbh(long_input);
+    EXPECT_EQ(long_input.begin() + 4000000, best.begin());
+    EXPECT_EQ(3, best.sum());
+  }
+}
@@ -0,0 +1,241 @@
+///////////////////////////////////////////////////////////////////////////////
+// poly_exp_fuzz.cpp
+//
+// Differential fuzzing for the functions in poly_exp.hpp. Every input is
+// given to each reference function and to each of its faster counterparts:
+//
+// - Maximum subarray engines must return exactly the span max_subarray_exh
+//   returns, except max_subarray_dbh, which breaks ties its own way; it must
+//   agree on the sum, and max_subarray_dbh_rescan and its fixed-size
+//   kernels must match it exactly.
+// - Subset sum engines may return different subsets, so each must agree
+//   with subset_sum_exh on whether a solution exists, and every subset
+//   returned must be a valid solution.
+//
+// The running time of every engine is accumulated, so performance
+// regressions show up alongside divergences.
+//
+// Built two ways:
+//
+// - With -DUSE_LIBFUZZER -fsanitize=fuzzer, as a libFuzzer target that
+//   decodes arbitrary bytes into inputs.
+// - Otherwise, as a standalone property-based test that feeds random bytes
+//   and every distribution from workloads.hpp at several sizes, then prints
+//   the time spent in each engine. Usage: poly_exp_fuzz [iterations [seed]]
+//
+// The Makefile builds both under AddressSanitizer and
+// UndefinedBehaviorSanitizer, so that an engine reading out of bounds or
+// overflowing fails even when its result happens to agree.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <numeric>
+#include <optional>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "timer.hpp"
+#include "workloads.hpp"
+
+#include "poly_exp.hpp"
+
+// Total seconds spent in each engine, by name.
+std::map<std::string, double> engine_seconds;
+
+// Run engine, charging its running time to name.
+template <typename Engine>
+auto timed(const std::string& name, Engine engine) {
+  Timer timer;
+  auto result = engine();
+  engine_seconds[name] += timer.elapsed();
+  return result;
+}
+
+// Abort with a description when an engine disagrees with its reference.
+void expect(bool agrees, const std::string& engine, size_t input_size) {
+  if (!agrees) {
+    std::cerr << "MISMATCH: " << engine << " disagrees with its reference on an input of size "
+              << input_size << std::endl;
+    std::abort();
+  }
+}
+
+// Whether two summed_spans have equal iterators and equal sums.
+bool identical(const subarray::summed_span& a, const subarray::summed_span& b) {
+  return (a == b) && (a.sum() == b.sum());
+}
+
+// Largest inputs given to the cubic and exponential references.
+constexpr size_t max_subarray_input_limit = 200, subset_sum_input_limit = 16;
+
+void check_max_subarray(const std::vector<int>& input) {
+  if (input.empty() || input.size() > max_subarray_input_limit) {
+    return;
+  }
+  const size_t n = input.size();
+  auto expected = timed("max_subarray_exh", [&] { return subarray::max_subarray_exh(input); });
+
+  for (auto level : cpu_dispatch::supported_levels()) {
+    cpu_dispatch::ScopedLevel scope(level);
+    const std::string engine =
+      std::string("max_subarray_exh_quadratic (") + cpu_dispatch::name(level) + ")";
+    expect(identical(expected, timed(engine, [&] {
+             return subarray::max_subarray_exh_quadratic(input, 2);
+           })), engine, n);
+  }
+  expect(identical(expected, timed("max_subarray_parallel", [&] {
+           return subarray::max_subarray_parallel(input, 3);
+         })), "max_subarray_parallel", n);
+  expect(identical(expected, timed("max_subarrays_top_k", [&] {
+           return subarray::max_subarrays_top_k(input, 1).front();
+         })), "max_subarrays_top_k", n);
+  expect(identical(expected, timed("max_subarrays_top_k_disjoint", [&] {
+           return subarray::max_subarrays_top_k_disjoint(input, 1).front();
+         })), "max_subarrays_top_k_disjoint", n);
+  expect(identical(expected, timed("max_subarray_length_bounded", [&] {
+           return subarray::max_subarray_length_bounded(input, 1, n);
+         })), "max_subarray_length_bounded", n);
+  for (auto level : cpu_dispatch::supported_levels()) {
+    cpu_dispatch::ScopedLevel scope(level);
+    const std::string engine = std::string("max_subarray_batch (") + cpu_dispatch::name(level) + ")";
+    // one full block of copies, so the vector kernel runs, and one leftover
+    const std::vector<std::vector<int>> copies(subarray::kernels::batch_lanes + 1, input);
+    auto batch = timed(engine, [&] {
+      return subarray::max_subarray_batch(subarray::interleaved_arrays(copies));
+    });
+    for (size_t i = 0; i < copies.size(); ++i) {
+      expect(identical(expected, batch.at(i).to_summed_span(input)), engine, n);
+    }
+  }
+  auto rectangle = timed("max_submatrix", [&] {
+    return subarray::max_submatrix(input, 1, n, 2);
+  });
+  expect(rectangle.left == size_t(expected.begin() - input.begin()) &&
+         rectangle.right == size_t(expected.end() - input.begin()) &&
+         rectangle.sum == expected.sum(), "max_submatrix", n);
+
+  auto halving = timed("max_subarray_dbh", [&] { return subarray::max_subarray_dbh(input); });
+  expect(halving.sum() == expected.sum(), "max_subarray_dbh (sum)", n);
+  expect(identical(halving, timed("max_subarray_dbh_rescan", [&] {
+           return subarray::max_subarray_dbh_rescan(input);
+         })), "max_subarray_dbh (against max_subarray_dbh_rescan)", n);
+  expect(identical(halving, timed("max_subarray_dbh_auto", [&] {
+           return subarray::max_subarray_dbh_auto(input);
+         })), "max_subarray_dbh_auto", n);
+}
+
+// Whether result agrees with the reference on existence and, if it has a
+// subset, that subset is a solution.
+bool agrees(const std::optional<std::vector<int>>& expected,
+            const std::optional<std::vector<int>>& result,
+            const std::vector<int>& input, int target) {
+  return expected.has_value() == result.has_value() &&
+         (!result || subarray::is_subset_sum_solution(input, *result, target));
+}
+
+void check_subset_sum(const std::vector<int>& input, int target) {
+  if (input.empty() || input.size() > subset_sum_input_limit) {
+    return;
+  }
+  const size_t n = input.size();
+  auto expected = timed("subset_sum_exh", [&] { return subarray::subset_sum_exh(input, target); });
+
+  expect(agrees(expected, timed("subset_sum_exh_auto", [&] {
+           return subarray::subset_sum_exh_auto(input, target);
+         }), input, target), "subset_sum_exh_auto", n);
+  expect(agrees(expected, timed("subset_sum_exh_resumable", [&] {
+           return subarray::subset_sum_exh_resumable(input, target).subset;
+         }), input, target), "subset_sum_exh_resumable", n);
+  expect(agrees(expected, timed("subset_sum_bnb", [&] {
+           return subarray::subset_sum_bnb(input, target);
+         }), input, target), "subset_sum_bnb", n);
+  expect(agrees(expected, timed("subset_sum_index::find", [&] {
+           return subarray::subset_sum_index(input).find(target);
+         }), input, target), "subset_sum_index::find", n);
+  expect(agrees(expected, timed("subset_sum_index::find_all", [&] {
+           return subarray::subset_sum_index(input).find_all({target}).front();
+         }), input, target), "subset_sum_index::find_all", n);
+  expect(agrees(expected, timed("subset_sum_solutions", [&] {
+           return subarray::subset_sum_solutions(input, target).next();
+         }), input, target), "subset_sum_solutions", n);
+  expect(expected.has_value() == (timed("subset_sum_count", [&] {
+           return subarray::subset_sum_count(input, target);
+         }) > 0), "subset_sum_count", n);
+
+  std::optional<std::vector<int>> any_size;
+  for (size_t k = 1; k <= n && !any_size; ++k) {
+    any_size = timed("subset_sum_k", [&] { return subarray::subset_sum_k(input, k, target); });
+    expect(!any_size || (any_size->size() == k && subarray::is_subset_sum_solution(input, *any_size, target)),
+           "subset_sum_k", n);
+  }
+  expect(expected.has_value() == any_size.has_value(), "subset_sum_k", n);
+}
+
+// Decode bytes into the inputs of every check. The first byte picks how
+// values are decoded: a tiny alphabet, so that ties and solutions are
+// common, or the full range of a signed byte. The second byte is the subset
+// sum target.
+void check_bytes(const uint8_t* data, size_t size) {
+  if (size < 3) {
+    return;
+  }
+  const bool tiny = data[0] & 1;
+  const int target = tiny ? int(data[1] % 11) - 5 : int(int8_t(data[1]));
+  std::vector<int> values;
+  for (size_t i = 2; i < size; ++i) {
+    values.push_back(tiny ? int(data[i] % 5) - 2 : int(int8_t(data[i])));
+  }
+  check_max_subarray(values);
+  values.resize(std::min(values.size(), subset_sum_input_limit));
+  check_subset_sum(values, target);
+}
+
+#ifdef USE_LIBFUZZER
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+  check_bytes(data, size);
+  return 0;
+}
+
+#else
+
+int main(int argc, char* argv[]) {
+
+  const unsigned iterations = (argc > 1) ? std::atoi(argv[1]) : 2000;
+  std::mt19937 rng((argc > 2) ? std::atoi(argv[2]) : 0);
+
+  std::uniform_int_distribution<> random_size(0, 40), random_byte(0, 255);
+  for (unsigned i = 0; i < iterations; ++i) {
+    std::vector<uint8_t> bytes(random_size(rng));
+    for (auto& byte : bytes) {
+      byte = random_byte(rng);
+    }
+    check_bytes(bytes.data(), bytes.size());
+  }
+
+  for (size_t n : {1, 2, 3, 10, 100, 200}) {
+    for (const auto& workload : workloads::int_workloads()) {
+      check_max_subarray(workload.generate(n, rng));
+    }
+  }
+  for (size_t n : {1, 2, 3, 8, 16}) {
+    for (const auto& workload : workloads::subset_sum_workloads()) {
+      auto instance = workload.generate(n, rng);
+      check_subset_sum(instance.input, instance.target);
+    }
+  }
+
+  std::cout << "all engines agree" << std::endl;
+  for (const auto& [engine, seconds] : engine_seconds) {
+    std::cout << engine << ": " << seconds << " seconds" << std::endl;
+  }
+  return 0;
+}
+
+#endif
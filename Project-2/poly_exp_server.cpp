@@ -0,0 +1,44 @@
+///////////////////////////////////////////////////////////////////////////////
+// poly_exp_server.cpp
+//
+// Resident server for the operations in poly_exp_service.hpp. Runs until
+// interrupted, then prints the latency histogram of every operation.
+//
+// Usage: poly_exp_server [socket_path [threads]]
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include <csignal>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include <pthread.h>
+
+#include "poly_exp_service.hpp"
+
+int main(int argc, char* argv[]) {
+
+  const std::string path = (argc > 1) ? argv[1] : "/tmp/poly_exp.sock";
+  const unsigned threads = (argc > 2) ? std::atoi(argv[2]) : std::thread::hardware_concurrency();
+
+  // block the shutdown signals in every thread, and wait for them here
+  sigset_t signals;
+  sigemptyset(&signals);
+  sigaddset(&signals, SIGINT);
+  sigaddset(&signals, SIGTERM);
+  pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+  service::Server server(path, threads);
+  poly_exp_service::register_operations(server);
+  server.start();
+  std::cout << "serving on " << path << " with " << threads << " threads, instruction set "
+            << cpu_dispatch::name(cpu_dispatch::active()) << std::endl;
+
+  int signal = 0;
+  sigwait(&signals, &signal);
+  server.stop();
+  std::cout << server.stats();
+  return 0;
+}
@@ -0,0 +1,89 @@
+///////////////////////////////////////////////////////////////////////////////
+// poly_exp_service.hpp
+//
+// The operations poly_exp_server offers over service.hpp, and their payload
+// layouts. Integers are in native byte order.
+//
+// max_subarray (max_subarray_dbh_auto)
+// max_subarray_exh (max_subarray_exh_quadratic, on one thread)
+//   request:  int32 input[], nonempty, and for max_subarray_exh at most
+//             max_subarray_exh_limit elements
+//   response: uint64 begin, uint64 end, int64 sum
+//
+// subset_sum (subset_sum_bnb)
+//   request:  int32 target, then int32 input[], nonempty and at most
+//             subset_sum_limit elements
+//   response: uint8 found, then when found int32 subset[]
+//
+// Requests outside these bounds get status_bad_request. The limits keep one
+// request to the quadratic or exponential operations from occupying a pool
+// thread indefinitely.
+//
+// Subarray responses refer to the request by position instead of echoing
+// its values back.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "poly_exp.hpp"
+#include "service.hpp"
+
+namespace poly_exp_service {
+
+constexpr uint16_t max_subarray = 1,
+                   max_subarray_exh = 2,
+                   subset_sum = 3;
+
+// Most input elements accepted by each operation.
+constexpr size_t max_subarray_exh_limit = 1 << 14,
+                 subset_sum_limit = 1 << 12;
+
+// Register every operation above with server.
+inline void register_operations(service::Server& server) {
+  auto subarray_handler = [](size_t limit, auto solve) {
+    return [limit, solve](service::PayloadReader& in, service::PayloadWriter& out) {
+      std::vector<int> input;
+      if (!in.read_rest(input) || input.empty() || input.size() > limit) {
+        return service::status_bad_request;
+      }
+      subarray::summed_span best = solve(input);
+      out.write(uint64_t(best.begin() - input.begin()));
+      out.write(uint64_t(best.end() - input.begin()));
+      out.write(int64_t(best.sum()));
+      return service::status_ok;
+    };
+  };
+  server.handle(max_subarray, "max_subarray",
+                subarray_handler(std::numeric_limits<size_t>::max(),
+                                 [](const std::vector<int>& input) {
+    return subarray::max_subarray_dbh_auto(input);
+  }));
+  server.handle(max_subarray_exh, "max_subarray_exh",
+                subarray_handler(max_subarray_exh_limit, [](const std::vector<int>& input) {
+    return subarray::max_subarray_exh_quadratic(input, 1);
+  }));
+
+  server.handle(subset_sum, "subset_sum", [](service::PayloadReader& in,
+                                             service::PayloadWriter& out) {
+    int32_t target;
+    std::vector<int> input;
+    if (!in.read(target) || !in.read_rest(input) || input.empty() ||
+        input.size() > subset_sum_limit) {
+      return service::status_bad_request;
+    }
+    auto solution = subarray::subset_sum_bnb(input, target);
+    out.write(uint8_t(solution.has_value()));
+    if (solution) {
+      out.write_array(*solution);
+    }
+    return service::status_ok;
+  });
+}
+
+}
@@ -5,15 +5,28 @@
 // elapsed times precisely. You should modify this program to gather
 // all of your experimental data.
 //
+// Usage: poly_exp_timing [--large]
+//
+// --large adds scans of 100 million elements, which allocate two inputs of
+// 400 MB each.
+//
 ///////////////////////////////////////////////////////////////////////////////
 
 #include <algorithm>
 #include <cassert>
+#include <cstdio>
 #include <iostream>
 #include <random>
+#include <string>
+#include <thread>
 #include <vector>
 
+#include <unistd.h>
+
+#include "alloc_tracker.hpp"
+#include "huge_buffer.hpp"
 #include "timer.hpp"
+#include "workloads.hpp"
 
 #include "poly_exp.hpp"
 
@@ -21,6 +34,25 @@ void print_bar() {
   std::cout << std::string(79, '-') << std::endl;
 }
 
+// Time algorithm on an input of size n from every workload in list, printing
+// one line per workload.
+template <typename T, typename Algorithm>
+void sweep(const std::string& title, const std::vector<workloads::Workload<T>>& list,
+           size_t n, Algorithm algorithm) {
+  print_bar();
+  std::cout << title << ", all workloads" << std::endl;
+  std::mt19937 rng(0);
+  for (const auto& workload : list) {
+    T input = workload.generate(n, rng);
+    AllocScope scope;
+    Timer timer;
+    algorithm(input);
+    double elapsed = timer.elapsed();
+    std::cout << workload.name << ": elapsed time=" << elapsed << " seconds, "
+              << scope.stats() << std::endl;
+  }
+}
+
 void print_int_vector(const std::vector<int>& v) {
   std::cout << "{";
   bool first = true;
@@ -35,13 +67,17 @@ void print_int_vector(const std::vector<int>& v) {
   std::cout << "}";
 }
 
-int main() {
+int main(int argc, char* argv[]) {
+
+  const bool large = (argc > 1) && (std::string(argv[1]) == "--large");
 
   // Feel free to change these constants to suit your needs.
   const size_t n = 20,
                print_input_limit = 100,
                max_subarray_exh_limit = 10000,
-               subset_sum_exh_limit = 28;
+               max_subarray_exh_quadratic_limit = 1000000,
+               subset_sum_exh_limit = 28,
+               subset_sum_exh_resumable_limit = 40;
 
   assert(n > 0);
 
@@ -61,9 +97,12 @@ int main() {
 
   Timer timer;
   double elapsed;
+  AllocStats allocs;
 
   print_bar();
   std::cout << "n = " << n << std::endl;
+  std::cout << "active instruction set: " << cpu_dispatch::name(cpu_dispatch::active())
+            << std::endl;
   if (n > print_input_limit) {
     std::cout << "(input too large to print)" << std::endl;
   } else {
@@ -78,11 +117,14 @@ int main() {
   print_bar();
   std::cout << "max_subarray_dc" << std::endl;
   {
+    AllocScope scope;
     timer.reset();
     auto solution = subarray::max_subarray_dbh(subarray_input);
     elapsed = timer.elapsed();
+    allocs = scope.stats();
     std::cout << "solution: " << solution << std::endl
-              << "elapsed time=" << elapsed << " seconds" << std::endl;
+              << "elapsed time=" << elapsed << " seconds" << std::endl
+              << allocs << std::endl;
   }
 
   print_bar();
@@ -90,11 +132,29 @@ int main() {
   if (n > max_subarray_exh_limit) {
     std::cout << "(skipped because n > " << max_subarray_exh_limit << ")" << std::endl;
   } else {
+    AllocScope scope;
     timer.reset();
     auto solution = subarray::max_subarray_exh(subarray_input);
     elapsed = timer.elapsed();
+    allocs = scope.stats();
     std::cout << "solution: " << solution << std::endl
-              << "elapsed time=" << elapsed << " seconds" << std::endl;
+              << "elapsed time=" << elapsed << " seconds" << std::endl
+              << allocs << std::endl;
+  }
+
+  print_bar();
+  std::cout << "max_subarray_exh_quadratic" << std::endl;
+  if (n > max_subarray_exh_quadratic_limit) {
+    std::cout << "(skipped because n > " << max_subarray_exh_quadratic_limit << ")" << std::endl;
+  } else {
+    AllocScope scope;
+    timer.reset();
+    auto solution = subarray::max_subarray_exh_quadratic(subarray_input);
+    elapsed = timer.elapsed();
+    allocs = scope.stats();
+    std::cout << "solution: " << solution << std::endl
+              << "elapsed time=" << elapsed << " seconds" << std::endl
+              << allocs << std::endl;
   }
 
   print_bar();
@@ -102,9 +162,11 @@ int main() {
   if (n > subset_sum_exh_limit) {
     std::cout << "(skipped because n > " << subset_sum_exh_limit << ")" << std::endl;
   } else {
+    AllocScope scope;
     timer.reset();
     auto solution = subarray::subset_sum_exh(subset_sum_input, 1);
     elapsed = timer.elapsed();
+    allocs = scope.stats();
     std::cout << "solution:" << std::endl;
     if (!solution.has_value()) {
       std::cout << "(no solution)" << std::endl;
@@ -114,7 +176,130 @@ int main() {
                 << std::accumulate(solution->begin(), solution->end(), 0)
                 << std::endl;
     }
-    std::cout << "elapsed time=" << elapsed << " seconds" << std::endl;
+    std::cout << "elapsed time=" << elapsed << " seconds" << std::endl
+              << allocs << std::endl;
+  }
+
+  print_bar();
+  std::cout << "subset_sum_exh_resumable" << std::endl;
+  if (n > subset_sum_exh_resumable_limit) {
+    std::cout << "(skipped because n > " << subset_sum_exh_resumable_limit << ")" << std::endl;
+  } else {
+    subarray::exh_resumable_options options;
+    options.checkpoint_path = "/tmp/poly_exp_timing." + std::to_string(getpid()) + ".checkpoint";
+    options.threads = std::thread::hardware_concurrency();
+    options.on_progress = [](const subarray::exh_progress& progress) {
+      std::cout << "progress: " << progress.masks_done << " / " << progress.masks_total
+                << " masks, " << progress.masks_per_second << " masks/second" << std::endl;
+    };
+    AllocScope scope;
+    timer.reset();
+    auto result = subarray::subset_sum_exh_resumable(subset_sum_input, 1, options);
+    elapsed = timer.elapsed();
+    allocs = scope.stats();
+    std::cout << "solution:" << std::endl;
+    if (!result.subset.has_value()) {
+      std::cout << "(no solution)" << std::endl;
+    } else {
+      print_int_vector(*result.subset);
+      std::cout << std::endl;
+    }
+    std::cout << "elapsed time=" << elapsed << " seconds" << std::endl
+              << allocs << std::endl;
+    // an unfinished search leaves its checkpoint behind
+    std::remove(options.checkpoint_path.c_str());
+    std::remove((options.checkpoint_path + ".tmp").c_str());
+  }
+
+  print_bar();
+  std::cout << "subset_sum_exh, memoized, repeated 10 times" << std::endl;
+  if (n > subset_sum_exh_limit) {
+    std::cout << "(skipped because n > " << subset_sum_exh_limit << ")" << std::endl;
+  } else {
+    subarray::subset_sum_cache cache(100);
+    for (size_t i = 0; i < 10; ++i) {
+      AllocScope scope;
+      timer.reset();
+      subarray::subset_sum_exh_memo(subset_sum_input, 1, cache);
+      elapsed = timer.elapsed();
+      allocs = scope.stats();
+      std::cout << "elapsed time=" << elapsed << " seconds, " << allocs << std::endl;
+    }
+    std::cout << cache.stats() << std::endl;
+  }
+
+  // Linear scans at large n, of an ordinary vector built with push_back and
+  // of a huge-page buffer placed by first touch.
+  if (large) {
+    const size_t large_n = 100*1000*1000;
+    const unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    auto value = [](size_t i) { return int((i * 2654435761u) % 201) - 100; };
+
+    print_bar();
+    std::cout << "max_subarray_parallel, n=" << large_n << ", " << threads << " threads"
+              << std::endl;
+
+    timer.reset();
+    std::vector<int> ordinary;
+    for (size_t i = 0; i < large_n; ++i) {
+      ordinary.push_back(value(i));
+    }
+    std::cout << "std::vector built with push_back: " << timer.elapsed() << " seconds"
+              << std::endl;
+    timer.reset();
+    subarray::max_subarray_parallel(ordinary, 1);
+    std::cout << "one thread: elapsed time=" << timer.elapsed() << " seconds" << std::endl;
+    timer.reset();
+    subarray::max_subarray_parallel(ordinary, threads);
+    std::cout << "std::vector: elapsed time=" << timer.elapsed() << " seconds" << std::endl;
+
+    timer.reset();
+    HugeBuffer<int> huge(large_n, threads, value);
+    std::cout << "HugeBuffer built by first touch: " << timer.elapsed() << " seconds, "
+              << (huge.explicit_huge_pages() ? "explicit" : "transparent") << " huge pages"
+              << std::endl;
+    timer.reset();
+    subarray::max_subarray_parallel(huge.data(), huge.size(), threads);
+    std::cout << "HugeBuffer: elapsed time=" << timer.elapsed() << " seconds" << std::endl;
+  }
+
+  sweep("max_subarray_dbh", workloads::int_workloads(), n,
+        [](const std::vector<int>& input) { subarray::max_subarray_dbh(input); });
+  sweep("max_subarray_dbh, n=1,000,000", workloads::int_workloads(), 1000*1000,
+        [](const std::vector<int>& input) { subarray::max_subarray_dbh(input); });
+  sweep("max_subarray_dbh_rescan, n=1,000,000", workloads::int_workloads(), 1000*1000,
+        [](const std::vector<int>& input) { subarray::max_subarray_dbh_rescan(input); });
+  for (auto level : cpu_dispatch::supported_levels()) {
+    cpu_dispatch::ScopedLevel scope(level);
+    sweep(std::string("max_subarray_exh_quadratic, vectorized for ") + cpu_dispatch::name(level) +
+          ", n=10,000", workloads::int_workloads(), 10*1000,
+          [](const std::vector<int>& input) { subarray::max_subarray_exh_quadratic(input); });
+  }
+  for (auto level : cpu_dispatch::supported_levels()) {
+    cpu_dispatch::ScopedLevel scope(level);
+    // the input, read as 16,384 interleaved arrays of 64 elements
+    sweep(std::string("max_subarray_batch, vectorized for ") + cpu_dispatch::name(level) +
+          ", 16,384 arrays of 64", workloads::int_workloads(), 64*16384,
+          [](const std::vector<int>& input) {
+            subarray::max_subarray_batch(
+              subarray::interleaved_arrays(input, std::vector<uint32_t>(16384, 64)));
+          });
+  }
+  for (auto level : cpu_dispatch::supported_levels()) {
+    cpu_dispatch::ScopedLevel scope(level);
+    sweep(std::string("max_submatrix, vectorized for ") + cpu_dispatch::name(level) +
+          ", 128x512 grid", workloads::int_workloads(), 128*512,
+          [](const std::vector<int>& input) { subarray::max_submatrix(input, 128, 512); });
+  }
+  if (n <= max_subarray_exh_limit) {
+    sweep("max_subarray_exh", workloads::int_workloads(), n,
+          [](const std::vector<int>& input) { subarray::max_subarray_exh(input); });
+  }
+  if (n <= subset_sum_exh_limit) {
+    sweep("subset_sum_exh", workloads::subset_sum_workloads(), n,
+          [](const workloads::SubsetSumInstance& instance) {
+            subarray::subset_sum_exh(instance.input, instance.target);
+          });
   }
 
   print_bar();
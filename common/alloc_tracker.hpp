@@ -0,0 +1,195 @@
+///////////////////////////////////////////////////////////////////////////////
+// alloc_tracker.hpp
+//
+// Heap allocation instrumentation for measuring code.
+//
+// Including this header replaces the global operator new and operator
+// delete with versions that count every allocation, so it must be included
+// in exactly one translation unit of a program, and only in programs that
+// want the instrumentation (such as the timing drivers). Each block carries a
+// small header recording its size, so frees are accounted exactly even when
+// the unsized operator delete is used.
+//
+// How to use:
+//
+//    AllocScope allocs;
+//    // run the code you want measured
+//    AllocStats stats = allocs.stats();
+//    cout << "allocations: " << stats.allocations << endl;
+//
+// Scopes may be nested; each reports the peak live bytes reached while it
+// was open, relative to the live bytes when it was opened.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <ostream>
+
+// Counts of heap activity over some region of code.
+struct AllocStats {
+  uint64_t allocations = 0, deallocations = 0;
+  uint64_t bytes_allocated = 0;
+  uint64_t peak_live_bytes = 0;
+
+  friend std::ostream& operator<<(std::ostream& stream, const AllocStats& rhs) {
+    stream << "allocations=" << rhs.allocations
+           << ", deallocations=" << rhs.deallocations
+           << ", bytes=" << rhs.bytes_allocated
+           << ", peak live bytes=" << rhs.peak_live_bytes;
+    return stream;
+  }
+};
+
+namespace alloc_tracker {
+
+// Process-wide counters, updated by the replacement operators below.
+inline std::atomic<uint64_t> allocations(0), deallocations(0),
+                             bytes_allocated(0), live_bytes(0), peak_live_bytes(0);
+
+inline void record_allocation(size_t size) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  bytes_allocated.fetch_add(size, std::memory_order_relaxed);
+  uint64_t live = live_bytes.fetch_add(size, std::memory_order_relaxed) + size;
+  uint64_t peak = peak_live_bytes.load(std::memory_order_relaxed);
+  while (live > peak &&
+         !peak_live_bytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {
+  }
+}
+
+inline void record_deallocation(size_t size) {
+  deallocations.fetch_add(1, std::memory_order_relaxed);
+  live_bytes.fetch_sub(size, std::memory_order_relaxed);
+}
+
+// Every block starts with a header this large, holding the requested size,
+// so that the pointer handed out keeps the default new alignment.
+constexpr size_t header_size = __STDCPP_DEFAULT_NEW_ALIGNMENT__;
+
+inline void* allocate(size_t size, size_t alignment) {
+  const size_t header = std::max(header_size, alignment);
+  size_t total = header + size;
+  void* base = (alignment > header_size)
+    ? std::aligned_alloc(alignment, (total + alignment - 1) / alignment * alignment)
+    : std::malloc(total);
+  if (base == nullptr) {
+    return nullptr;
+  }
+  char* user = static_cast<char*>(base) + header;
+  reinterpret_cast<size_t*>(user)[-1] = size;
+  record_allocation(size);
+  return user;
+}
+
+inline void deallocate(void* pointer, size_t alignment) {
+  if (pointer == nullptr) {
+    return;
+  }
+  const size_t header = std::max(header_size, alignment);
+  char* user = static_cast<char*>(pointer);
+  record_deallocation(reinterpret_cast<size_t*>(user)[-1]);
+  std::free(user - header);
+}
+
+inline void* allocate_or_throw(size_t size, size_t alignment) {
+  if (void* pointer = allocate(size, alignment)) {
+    return pointer;
+  }
+  throw std::bad_alloc();
+}
+
+} // namespace alloc_tracker
+
+// Measures heap activity from its construction until stats() is called.
+class AllocScope {
+private:
+  uint64_t allocations_, deallocations_, bytes_allocated_;
+  uint64_t live_at_start_, outer_peak_;
+
+public:
+
+  // Start measuring.
+  AllocScope() {
+    using namespace alloc_tracker;
+    allocations_ = allocations.load();
+    deallocations_ = deallocations.load();
+    bytes_allocated_ = bytes_allocated.load();
+    live_at_start_ = live_bytes.load();
+    // Track this scope's peak from the current level, and restore the
+    // enclosing peak (if it was higher) when the scope closes.
+    outer_peak_ = peak_live_bytes.exchange(live_at_start_);
+  }
+
+  ~AllocScope() {
+    uint64_t peak = alloc_tracker::peak_live_bytes.load();
+    while (outer_peak_ > peak &&
+           !alloc_tracker::peak_live_bytes.compare_exchange_weak(peak, outer_peak_)) {
+    }
+  }
+
+  AllocScope(const AllocScope&) = delete;
+  AllocScope& operator=(const AllocScope&) = delete;
+
+  // Return the heap activity since this scope was opened.
+  AllocStats stats() const {
+    using namespace alloc_tracker;
+    AllocStats result;
+    result.allocations = allocations.load() - allocations_;
+    result.deallocations = deallocations.load() - deallocations_;
+    result.bytes_allocated = bytes_allocated.load() - bytes_allocated_;
+    result.peak_live_bytes = peak_live_bytes.load() - live_at_start_;
+    return result;
+  }
+};
+
+// Replacement global allocation functions.
+
+void* operator new(size_t size) {
+  return alloc_tracker::allocate_or_throw(size, 0);
+}
+void* operator new[](size_t size) {
+  return alloc_tracker::allocate_or_throw(size, 0);
+}
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+  return alloc_tracker::allocate(size, 0);
+}
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+  return alloc_tracker::allocate(size, 0);
+}
+void* operator new(size_t size, std::align_val_t alignment) {
+  return alloc_tracker::allocate_or_throw(size, size_t(alignment));
+}
+void* operator new[](size_t size, std::align_val_t alignment) {
+  return alloc_tracker::allocate_or_throw(size, size_t(alignment));
+}
+
+void operator delete(void* pointer) noexcept {
+  alloc_tracker::deallocate(pointer, 0);
+}
+void operator delete[](void* pointer) noexcept {
+  alloc_tracker::deallocate(pointer, 0);
+}
+void operator delete(void* pointer, size_t) noexcept {
+  alloc_tracker::deallocate(pointer, 0);
+}
+void operator delete[](void* pointer, size_t) noexcept {
+  alloc_tracker::deallocate(pointer, 0);
+}
+void operator delete(void* pointer, std::align_val_t alignment) noexcept {
+  alloc_tracker::deallocate(pointer, size_t(alignment));
+}
+void operator delete[](void* pointer, std::align_val_t alignment) noexcept {
+  alloc_tracker::deallocate(pointer, size_t(alignment));
+}
+void operator delete(void* pointer, size_t, std::align_val_t alignment) noexcept {
+  alloc_tracker::deallocate(pointer, size_t(alignment));
+}
+void operator delete[](void* pointer, size_t, std::align_val_t alignment) noexcept {
+  alloc_tracker::deallocate(pointer, size_t(alignment));
+}
@@ -0,0 +1,151 @@
+///////////////////////////////////////////////////////////////////////////////
+// cpu_dispatch.hpp
+//
+// Runtime selection among instruction set variants of a kernel.
+//
+// A kernel is compiled once per instruction set level, in the same
+// translation unit, by marking each variant with one of the
+// CPU_DISPATCH_TARGET_* attributes below. The program itself is built for
+// the baseline architecture, so one binary runs on every machine, and the
+// best level the CPU supports is detected with CPUID when the program
+// starts. Setting the CPU_DISPATCH environment variable to a level name
+// (scalar, sse4.2, avx2, avx512) selects a lower level instead.
+//
+// How to use:
+//
+//    auto kernel = cpu_dispatch::select(scalar_kernel, sse42_kernel,
+//                                       avx2_kernel, avx512_kernel);
+//    kernel(arguments);
+//
+//    // benchmark every variant this CPU supports
+//    for (auto level : cpu_dispatch::supported_levels()) {
+//      cpu_dispatch::ScopedLevel scope(level);
+//      // run the code you want timed
+//    }
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CPU_DISPATCH_X86 1
+#include <immintrin.h>
+#define CPU_DISPATCH_TARGET_SSE42 __attribute__((target("sse4.2,popcnt")))
+#define CPU_DISPATCH_TARGET_AVX2 __attribute__((target("avx2,bmi,bmi2,popcnt")))
+#define CPU_DISPATCH_TARGET_AVX512 __attribute__((target("avx512f,avx512bw,avx512vl,bmi,bmi2,popcnt")))
+#else
+#define CPU_DISPATCH_X86 0
+#endif
+
+namespace cpu_dispatch {
+
+// Instruction set levels, from least to most capable. Each level includes
+// everything below it.
+enum class level { scalar, sse42, avx2, avx512 };
+
+constexpr level all_levels[] = {level::scalar, level::sse42, level::avx2, level::avx512};
+
+inline const char* name(level l) {
+  switch (l) {
+  case level::scalar: return "scalar";
+  case level::sse42:  return "sse4.2";
+  case level::avx2:   return "avx2";
+  case level::avx512: return "avx512";
+  }
+  return "unknown";
+}
+
+// Whether this CPU can run code compiled for l.
+inline bool supported(level l) {
+#if CPU_DISPATCH_X86
+  switch (l) {
+  case level::scalar: return true;
+  case level::sse42:  return __builtin_cpu_supports("sse4.2") && __builtin_cpu_supports("popcnt");
+  case level::avx2:   return supported(level::sse42) && __builtin_cpu_supports("avx2") &&
+                             __builtin_cpu_supports("bmi") && __builtin_cpu_supports("bmi2");
+  case level::avx512: return supported(level::avx2) && __builtin_cpu_supports("avx512f") &&
+                             __builtin_cpu_supports("avx512bw") &&
+                             __builtin_cpu_supports("avx512vl");
+  }
+  return false;
+#else
+  return l == level::scalar;
+#endif
+}
+
+// Every level this CPU supports, from least to most capable.
+inline std::vector<level> supported_levels() {
+  std::vector<level> result;
+  for (level l : all_levels) {
+    if (supported(l)) {
+      result.push_back(l);
+    }
+  }
+  return result;
+}
+
+// The level chosen at startup: the best supported level, lowered to the
+// level named by the CPU_DISPATCH environment variable if it is set.
+inline level startup_level() {
+  level best = supported_levels().back();
+  if (const char* requested = std::getenv("CPU_DISPATCH")) {
+    for (level l : all_levels) {
+      if (std::strcmp(requested, name(l)) == 0 && l < best) {
+        best = l;
+      }
+    }
+  }
+  return best;
+}
+
+namespace detail {
+inline level active = startup_level();
+}
+
+// The level kernels are currently dispatched to.
+inline level active() { return detail::active; }
+
+// Dispatch to l from now on. Returns false, changing nothing, when this CPU
+// does not support l. Not thread safe; change levels only while no kernels
+// are running.
+inline bool set_active(level l) {
+  if (!supported(l)) {
+    return false;
+  }
+  detail::active = l;
+  return true;
+}
+
+// Dispatch to a given level for the lifetime of this object, then restore
+// the previous level. The level must be supported.
+class ScopedLevel {
+private:
+  level previous_;
+
+public:
+  explicit ScopedLevel(level l) : previous_(active()) {
+    bool ok = set_active(l);
+    (void)ok;
+  }
+  ~ScopedLevel() { detail::active = previous_; }
+  ScopedLevel(const ScopedLevel&) = delete;
+  ScopedLevel& operator=(const ScopedLevel&) = delete;
+};
+
+// Choose the variant for the active level, given one variant per level.
+template <typename Kernel>
+Kernel select(Kernel scalar, Kernel sse42, Kernel avx2, Kernel avx512) {
+  switch (active()) {
+  case level::avx512: return avx512;
+  case level::avx2:   return avx2;
+  case level::sse42:  return sse42;
+  case level::scalar: return scalar;
+  }
+  return scalar;
+}
+
+}
@@ -0,0 +1,50 @@
+///////////////////////////////////////////////////////////////////////////////
+// fixed_size.hpp
+//
+// Routing small runtime-sized inputs to kernels specialized at compile time
+// for one size.
+//
+// A kernel templated on std::array<T, N> can be unrolled and kept in
+// registers, but only for sizes known at compile time. fixed_size::call
+// instantiates the kernel for every N in a range, and calls the one whose N
+// equals the size of a vector, with a copy of the vector as a std::array.
+//
+// How to use:
+//
+//    if (values.size() <= 16) {
+//      return fixed_size::call<1, 16>(values, [](const auto& array) {
+//        return kernel(array);
+//      });
+//    }
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <vector>
+
+namespace fixed_size {
+
+// Call kernel with a std::array<T, N> copy of values, where N ==
+// values.size(), choosing among the instantiations for N in [First, Last].
+// values.size() must be in that range.
+template <size_t First, size_t Last, typename T, typename Kernel>
+auto call(const std::vector<T>& values, Kernel&& kernel) {
+  if constexpr (First == Last) {
+    assert(values.size() == First);
+    std::array<T, First> copy{};
+    std::copy(values.begin(), values.end(), copy.begin());
+    return kernel(copy);
+  } else {
+    if (values.size() == First) {
+      return call<First, First>(values, kernel);
+    }
+    return call<First + 1, Last>(values, kernel);
+  }
+}
+
+}
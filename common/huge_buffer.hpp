@@ -0,0 +1,254 @@
+///////////////////////////////////////////////////////////////////////////////
+// huge_buffer.hpp
+//
+// Input buffers for very large runs, backed by 2 MB huge pages and placed
+// on the NUMA nodes of the threads that scan them.
+//
+// At hundreds of millions of elements, a scan over 4 KB pages misses the
+// TLB constantly, and on a multi-socket machine most of a buffer filled by
+// one thread lives on that thread's node. A HugeBuffer instead maps its
+// memory aligned to 2 MB and asks for huge pages, either transparent ones
+// (madvise) or, optionally, explicit ones from the hugetlbfs pool. It is
+// then initialized by first touch: numa::for_each_partition splits the
+// buffer into one contiguous partition per thread, and pins each thread to
+// a CPU chosen node by node, so that every page is first written, and
+// therefore placed, on the node of the thread that owns it. Engines that
+// scan through numa::for_each_partition with the same thread count get the
+// same partitions on the same CPUs, so each thread reads node-local memory.
+//
+// How to use:
+//
+//    HugeBuffer<int> values(n, threads, [&](size_t i) { return generate(i); });
+//    numa::for_each_partition(values.size(), threads,
+//                             [&](unsigned thread, size_t begin, size_t end) {
+//      // scan values[begin, end)
+//    });
+//
+// Topology is read from /sys/devices/system/node; without it, every CPU is
+// treated as one node, and the buffer is still huge-page backed.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <new>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+
+namespace numa {
+
+// The CPUs of every NUMA node, in node order.
+inline std::vector<std::vector<unsigned>> node_cpus() {
+  std::vector<std::vector<unsigned>> nodes;
+  for (unsigned node = 0; ; ++node) {
+    std::ifstream file("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+    if (!file) {
+      break;
+    }
+    // a comma-separated list of CPUs and ranges, such as 0-3,8-11
+    std::vector<unsigned> cpus;
+    std::string range;
+    while (std::getline(file, range, ',')) {
+      unsigned first, last;
+      char dash;
+      std::istringstream in(range);
+      if (!(in >> first)) {
+        continue;
+      }
+      last = (in >> dash >> last) ? last : first;
+      for (unsigned cpu = first; cpu <= last; ++cpu) {
+        cpus.push_back(cpu);
+      }
+    }
+    if (!cpus.empty()) {
+      nodes.push_back(std::move(cpus));
+    }
+  }
+  if (nodes.empty()) {
+    nodes.emplace_back();
+    for (unsigned cpu = 0; cpu < std::max(1u, std::thread::hardware_concurrency()); ++cpu) {
+      nodes.back().push_back(cpu);
+    }
+  }
+  return nodes;
+}
+
+// The CPU for each of threads workers. CPUs are listed node by node and
+// spread evenly over the workers, so consecutive workers, and the
+// consecutive partitions they own, share a node.
+inline std::vector<unsigned> worker_cpus(unsigned threads) {
+  std::vector<unsigned> all;
+  for (const auto& cpus : node_cpus()) {
+    all.insert(all.end(), cpus.begin(), cpus.end());
+  }
+  std::vector<unsigned> result(threads);
+  for (unsigned i = 0; i < threads; ++i) {
+    result[i] = all[size_t(i) * all.size() / threads];
+  }
+  return result;
+}
+
+// Pin the calling thread to cpu. Returns false when that is not allowed.
+inline bool pin_current_thread(unsigned cpu) {
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+// Split [0, n) into threads contiguous partitions of nearly equal size, and
+// call f(thread, begin, end) for each on a new thread pinned to
+// worker_cpus(threads)[thread]. Returns when every call has returned.
+template <typename Function>
+void for_each_partition(size_t n, unsigned threads, Function f) {
+  threads = std::max(1u, threads);
+  const std::vector<unsigned> cpus = worker_cpus(threads);
+  std::vector<std::thread> pool;
+  for (unsigned i = 0; i < threads; ++i) {
+    pool.emplace_back([&, i] {
+      pin_current_thread(cpus[i]);
+      f(i, n * i / threads, n * (i + 1) / threads);
+    });
+  }
+  for (auto& thread : pool) {
+    thread.join();
+  }
+}
+
+}
+
+// A fixed-size array of T in huge-page memory, initialized by first touch
+// from numa::for_each_partition. T must be trivially copyable. Move-only.
+template <typename T>
+class HugeBuffer {
+  static_assert(std::is_trivially_copyable_v<T>, "T must be trivially copyable");
+
+public:
+  static constexpr size_t huge_page_bytes = size_t(2) << 20;
+
+private:
+  T* data_ = nullptr;
+  size_t size_ = 0, mapped_bytes_ = 0;
+  bool explicit_pages_ = false;
+
+  // Map bytes of memory aligned to a huge page, preferring explicit huge
+  // pages when asked, and otherwise advising transparent ones.
+  void map(size_t bytes, bool explicit_pages) {
+    mapped_bytes_ = std::max(huge_page_bytes,
+                             (bytes + huge_page_bytes - 1) / huge_page_bytes * huge_page_bytes);
+#ifdef MAP_HUGETLB
+    if (explicit_pages) {
+      void* p = ::mmap(nullptr, mapped_bytes_, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+      if (p != MAP_FAILED) {
+        data_ = static_cast<T*>(p);
+        explicit_pages_ = true;
+        return;
+      }
+    }
+#endif
+    // over-map by one huge page, then trim to an aligned range
+    const size_t padded = mapped_bytes_ + huge_page_bytes;
+    void* p = ::mmap(nullptr, padded, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) {
+      throw std::bad_alloc();
+    }
+    const uintptr_t start = reinterpret_cast<uintptr_t>(p),
+                    aligned = (start + huge_page_bytes - 1) / huge_page_bytes * huge_page_bytes;
+    if (aligned > start) {
+      ::munmap(p, aligned - start);
+    }
+    if (const size_t tail = (start + padded) - (aligned + mapped_bytes_)) {
+      ::munmap(reinterpret_cast<void*>(aligned + mapped_bytes_), tail);
+    }
+    data_ = reinterpret_cast<T*>(aligned);
+#ifdef MADV_HUGEPAGE
+    ::madvise(data_, mapped_bytes_, MADV_HUGEPAGE);
+#endif
+  }
+
+  void unmap() {
+    if (data_) {
+      ::munmap(data_, mapped_bytes_);
+      data_ = nullptr;
+    }
+  }
+
+public:
+
+  HugeBuffer() = default;
+
+  // Allocate size elements and set element i to init(i), with each
+  // partition of numa::for_each_partition(size, threads) written by its
+  // own thread. When explicit_pages is true, try explicit huge pages first.
+  // Throws std::bad_alloc when the memory cannot be mapped.
+  template <typename Init>
+  HugeBuffer(size_t size, unsigned threads, Init init, bool explicit_pages = false)
+  : size_(size) {
+    map(size * sizeof(T), explicit_pages);
+    numa::for_each_partition(size, threads, [&](unsigned, size_t begin, size_t end) {
+      for (size_t i = begin; i < end; ++i) {
+        data_[i] = init(i);
+      }
+    });
+  }
+
+  // Allocate size zero elements, placed by first touch as above.
+  HugeBuffer(size_t size, unsigned threads)
+  : HugeBuffer(size, threads, [](size_t) { return T{}; }) {}
+
+  ~HugeBuffer() { unmap(); }
+
+  HugeBuffer(HugeBuffer&& other) noexcept { *this = std::move(other); }
+
+  HugeBuffer& operator=(HugeBuffer&& other) noexcept {
+    if (this != &other) {
+      unmap();
+      data_ = std::exchange(other.data_, nullptr);
+      size_ = std::exchange(other.size_, 0);
+      mapped_bytes_ = std::exchange(other.mapped_bytes_, 0);
+      explicit_pages_ = other.explicit_pages_;
+    }
+    return *this;
+  }
+
+  HugeBuffer(const HugeBuffer&) = delete;
+  HugeBuffer& operator=(const HugeBuffer&) = delete;
+
+  // Accessors.
+  T* data() { return data_; }
+  const T* data() const { return data_; }
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+  T* begin() { return data_; }
+  T* end() { return data_ + size_; }
+  const T* begin() const { return data_; }
+  const T* end() const { return data_ + size_; }
+
+  T& operator[](size_t i) {
+    assert(i < size_);
+    return data_[i];
+  }
+  const T& operator[](size_t i) const {
+    assert(i < size_);
+    return data_[i];
+  }
+
+  // Whether the memory came from the explicit huge page pool, rather than
+  // from transparent huge pages.
+  bool explicit_huge_pages() const { return explicit_pages_; }
+};
@@ -0,0 +1,473 @@
+///////////////////////////////////////////////////////////////////////////////
+// result_cache.hpp
+//
+// Content-addressed memoization for expensive functions.
+//
+// A result is stored under a 128-bit CacheKey hashed from the contents of
+// the function's input, its parameters, and a name for the function, so
+// identical queries hit no matter which vector object holds the input.
+// Results live in a bounded in-memory LRU. An optional second tier is a
+// direct-mapped table in a memory-mapped file, which outlives the process
+// and can be shared by every process that opens the same file with the same
+// layout.
+//
+// How to use:
+//
+//    using namespace result_cache;
+//    ResultCache<std::optional<std::vector<int>>> cache(1000);
+//    CacheKey key = KeyHasher("subset_sum").add_array(input).add(target).key();
+//    auto result = cache.get_or_compute(key, [&] { return solve(input, target); });
+//    cout << cache.stats() << endl;
+//
+// Values are stored by copying their bytes, so Value must be a trivially
+// copyable type, or a std::vector or std::optional of one.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace result_cache {
+
+constexpr uint64_t prime1 = 0x9e3779b97f4a7c15, prime2 = 0xc2b2ae3d27d4eb4f,
+                   prime3 = 0x165667b19e3779f9, prime4 = 0xd6e8feb86659fd93;
+
+// Multiply a and b to 128 bits and fold the halves together.
+inline uint64_t fold_multiply(uint64_t a, uint64_t b) {
+  __uint128_t product = __uint128_t(a) * b;
+  return uint64_t(product) ^ uint64_t(product >> 64);
+}
+
+// A fast non-cryptographic 64-bit hash of bytes. Four independent lanes
+// each consume 8 bytes per step, so long inputs hash at several bytes per
+// cycle.
+inline uint64_t hash64(const void* data, size_t size, uint64_t seed) {
+  const char* p = static_cast<const char*>(data);
+  auto word = [](const char* at) {
+    uint64_t w;
+    std::memcpy(&w, at, sizeof(w));
+    return w;
+  };
+  uint64_t lanes[4] = {seed ^ prime1, seed ^ prime2, seed ^ prime3, seed ^ prime4};
+  size_t i = 0;
+  for (; i + 32 <= size; i += 32) {
+    for (size_t lane = 0; lane < 4; ++lane) {
+      lanes[lane] = fold_multiply(lanes[lane] ^ word(p + i + 8 * lane), prime1 + 2 * lane);
+    }
+  }
+  uint64_t h = fold_multiply(lanes[0] ^ lanes[2], prime3) ^
+               fold_multiply(lanes[1] ^ lanes[3], prime4) ^ (size * prime2);
+  for (; i + 8 <= size; i += 8) {
+    h = fold_multiply(h ^ word(p + i), prime1);
+  }
+  if (i < size) {
+    uint64_t last = 0;
+    std::memcpy(&last, p + i, size - i);
+    h = fold_multiply(h ^ last, prime2);
+  }
+  return fold_multiply(h, prime4);
+}
+
+// The address of one result: two independently seeded 64-bit hashes, so
+// that a collision between different queries is negligibly unlikely.
+struct CacheKey {
+  uint64_t low = 0, high = 0;
+
+  bool operator==(const CacheKey& rhs) const { return low == rhs.low && high == rhs.high; }
+  bool operator!=(const CacheKey& rhs) const { return !(*this == rhs); }
+};
+
+// Build a CacheKey from a function name followed by any number of values
+// and arrays. Every piece is hashed with its length, so different splits
+// of the same bytes give different keys.
+class KeyHasher {
+private:
+  CacheKey key_;
+
+  KeyHasher& add_bytes(const void* data, size_t size) {
+    key_.low = fold_multiply(key_.low ^ hash64(data, size, key_.low), prime1);
+    key_.high = fold_multiply(key_.high ^ hash64(data, size, key_.high ^ prime3), prime2);
+    return *this;
+  }
+
+public:
+
+  explicit KeyHasher(std::string_view function) : key_{1, 2} {
+    add_bytes(function.data(), function.size());
+  }
+
+  template <typename T>
+  KeyHasher& add(const T& value) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    return add_bytes(&value, sizeof(value));
+  }
+
+  template <typename T>
+  KeyHasher& add_array(const std::vector<T>& values) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    return add_bytes(values.data(), values.size() * sizeof(T));
+  }
+
+  CacheKey key() const { return key_; }
+};
+
+// Counts of cache activity.
+struct CacheStats {
+  uint64_t memory_hits = 0, disk_hits = 0, misses = 0, evictions = 0;
+
+  uint64_t lookups() const { return memory_hits + disk_hits + misses; }
+
+  // Fraction of lookups answered from either tier, or 0 before any lookup.
+  double hit_rate() const {
+    return lookups() ? double(memory_hits + disk_hits) / lookups() : 0.0;
+  }
+};
+
+inline std::ostream& operator<<(std::ostream& out, const CacheStats& stats) {
+  return out << "cache lookups=" << stats.lookups()
+             << ", memory hits=" << stats.memory_hits
+             << ", disk hits=" << stats.disk_hits
+             << ", misses=" << stats.misses
+             << ", evictions=" << stats.evictions
+             << ", hit rate=" << stats.hit_rate();
+}
+
+// Append the bytes of value to out.
+template <typename T>
+void encode(const T& value, std::string& out) {
+  static_assert(std::is_trivially_copyable_v<T>);
+  out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template <typename T>
+void encode(const std::vector<T>& values, std::string& out) {
+  static_assert(std::is_trivially_copyable_v<T>);
+  encode(uint64_t(values.size()), out);
+  out.append(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T));
+}
+
+template <typename T>
+void encode(const std::optional<T>& value, std::string& out) {
+  encode(uint8_t(value.has_value()), out);
+  if (value) {
+    encode(*value, out);
+  }
+}
+
+// Read a value from the front of in, advancing past it. Returns false when
+// in is too short.
+template <typename T>
+bool decode(std::string_view& in, T& value) {
+  static_assert(std::is_trivially_copyable_v<T>);
+  if (in.size() < sizeof(value)) {
+    return false;
+  }
+  std::memcpy(&value, in.data(), sizeof(value));
+  in.remove_prefix(sizeof(value));
+  return true;
+}
+
+template <typename T>
+bool decode(std::string_view& in, std::vector<T>& values) {
+  uint64_t size;
+  if (!decode(in, size) || in.size() / sizeof(T) < size) {
+    return false;
+  }
+  values.resize(size);
+  std::memcpy(values.data(), in.data(), size * sizeof(T));
+  in.remove_prefix(size * sizeof(T));
+  return true;
+}
+
+template <typename T>
+bool decode(std::string_view& in, std::optional<T>& value) {
+  uint8_t present;
+  if (!decode(in, present)) {
+    return false;
+  }
+  if (!present) {
+    value.reset();
+    return true;
+  }
+  T inner;
+  if (!decode(in, inner)) {
+    return false;
+  }
+  value = std::move(inner);
+  return true;
+}
+
+// A direct-mapped table of encoded results in a memory-mapped file. Each
+// key has one slot, chosen by its hash; storing a result replaces whatever
+// was in its slot. Results longer than a slot are not stored. Each slot
+// holds a checksum of its contents, so a slot torn by a concurrent writer
+// in another process reads as a miss rather than as a wrong result.
+// Closing the table releases its lock on the file.
+class DiskTable {
+private:
+  struct FileHeader {
+    uint64_t magic, slot_count, slot_bytes;
+  };
+  struct SlotHeader {
+    CacheKey key;
+    uint64_t checksum;
+    uint32_t size, reserved;
+  };
+  static constexpr uint64_t magic = 0x31656863616372ULL;  // "rcache1"
+
+  int fd_ = -1;
+  char* map_ = nullptr;
+  size_t map_bytes_ = 0, slot_count_ = 0, slot_bytes_ = 0;
+
+  size_t stride() const { return sizeof(SlotHeader) + slot_bytes_; }
+
+  char* slot(const CacheKey& key) const {
+    return map_ + sizeof(FileHeader) + (key.low % slot_count_) * stride();
+  }
+
+  static uint64_t checksum(const CacheKey& key, std::string_view bytes) {
+    return hash64(bytes.data(), bytes.size(), key.low ^ key.high) | 1;
+  }
+
+  // Set this table's lock on the whole file to type, waiting for it if
+  // wait is true. These locks belong to the open file rather than to the
+  // process, so they also exclude other tables in this process, and
+  // changing from one type to the other is atomic.
+  bool lock(short type, bool wait) {
+    struct flock whole{};
+    whole.l_type = type;
+    whole.l_whence = SEEK_SET;
+    return ::fcntl(fd_, wait ? F_OFD_SETLKW : F_OFD_SETLK, &whole) == 0;
+  }
+
+  // Whether the file already holds a table with this layout.
+  bool has_layout() const {
+    struct stat info;
+    FileHeader header;
+    return ::fstat(fd_, &info) == 0 && size_t(info.st_size) == map_bytes_ &&
+           ::pread(fd_, &header, sizeof(header), 0) == ssize_t(sizeof(header)) &&
+           header.magic == magic && header.slot_count == slot_count_ &&
+           header.slot_bytes == slot_bytes_;
+  }
+
+  // Replace the contents of the file with an empty table of this layout.
+  // The write lock must be held.
+  bool format() {
+    const FileHeader header{magic, slot_count_, slot_bytes_};
+    return ::ftruncate(fd_, 0) == 0 && ::ftruncate(fd_, map_bytes_) == 0 &&
+           ::pwrite(fd_, &header, sizeof(header), 0) == ssize_t(sizeof(header));
+  }
+
+public:
+
+  // Open or create the table at path. Every open table holds a read lock on
+  // its file, so a file with a different layout is only reformatted when
+  // the write lock can be taken, which means no other table has it mapped.
+  // When the file is in use with another layout, or cannot be mapped, the
+  // table stays closed and every lookup misses.
+  DiskTable(const std::string& path, size_t slot_count, size_t slot_bytes)
+  : slot_count_(slot_count), slot_bytes_(slot_bytes) {
+    if (slot_count == 0) {
+      return;
+    }
+    fd_ = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd_ < 0) {
+      return;
+    }
+    map_bytes_ = sizeof(FileHeader) + slot_count * stride();
+    if (!lock(F_RDLCK, true) ||
+        (!has_layout() && !(lock(F_WRLCK, false) && format() && lock(F_RDLCK, false)))) {
+      close();
+      return;
+    }
+    void* map = ::mmap(nullptr, map_bytes_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+    if (map == MAP_FAILED) {
+      close();
+      return;
+    }
+    map_ = static_cast<char*>(map);
+  }
+
+  ~DiskTable() { close(); }
+
+  DiskTable(const DiskTable&) = delete;
+  DiskTable& operator=(const DiskTable&) = delete;
+
+  void close() {
+    if (map_) {
+      ::munmap(map_, map_bytes_);
+      map_ = nullptr;
+    }
+    if (fd_ >= 0) {
+      ::close(fd_);
+      fd_ = -1;
+    }
+  }
+
+  bool is_open() const { return map_ != nullptr; }
+
+  // The encoded result stored under key, if any.
+  std::optional<std::string> find(const CacheKey& key) const {
+    if (!is_open()) {
+      return std::nullopt;
+    }
+    const char* at = slot(key);
+    SlotHeader header;
+    std::memcpy(&header, at, sizeof(header));
+    if (header.key != key || header.size > slot_bytes_) {
+      return std::nullopt;
+    }
+    std::string bytes(at + sizeof(header), header.size);
+    if (header.checksum != checksum(key, bytes)) {
+      return std::nullopt;
+    }
+    return bytes;
+  }
+
+  // Store an encoded result under key, if it fits in a slot.
+  void store(const CacheKey& key, std::string_view bytes) {
+    if (!is_open() || bytes.size() > slot_bytes_) {
+      return;
+    }
+    char* at = slot(key);
+    SlotHeader header{key, checksum(key, bytes), uint32_t(bytes.size()), 0};
+    std::memcpy(at + sizeof(header), bytes.data(), bytes.size());
+    std::memcpy(at, &header, sizeof(header));
+  }
+};
+
+struct KeyHash {
+  size_t operator()(const CacheKey& key) const { return key.low; }
+};
+
+// A bounded memoization cache from CacheKey to Value. Safe to use from many
+// threads at once; computations on a miss run outside the lock, so two
+// threads missing on the same key may both compute it.
+template <typename Value>
+class ResultCache {
+private:
+  using entry = std::pair<CacheKey, Value>;
+
+  size_t capacity_;
+  std::list<entry> recency_;  // most recently used first
+  std::unordered_map<CacheKey, typename std::list<entry>::iterator,
+                     KeyHash> index_;
+  std::unique_ptr<DiskTable> disk_;
+  CacheStats stats_;
+  mutable std::mutex mutex_;
+
+  // Insert into the in-memory tier, evicting the least recently used entry
+  // when full. The lock must be held.
+  void remember(const CacheKey& key, Value value) {
+    if (auto found = index_.find(key); found != index_.end()) {
+      found->second->second = std::move(value);
+      recency_.splice(recency_.begin(), recency_, found->second);
+      return;
+    }
+    if (capacity_ == 0) {
+      return;
+    }
+    if (recency_.size() == capacity_) {
+      index_.erase(recency_.back().first);
+      recency_.pop_back();
+      ++stats_.evictions;
+    }
+    recency_.emplace_front(key, std::move(value));
+    index_[key] = recency_.begin();
+  }
+
+public:
+
+  // Keep up to capacity results in memory. When disk_path is nonempty, also
+  // keep results in a table of disk_slots slots of slot_bytes bytes each in
+  // that file.
+  explicit ResultCache(size_t capacity, const std::string& disk_path = "",
+                       size_t disk_slots = 1 << 16, size_t slot_bytes = 256)
+  : capacity_(capacity) {
+    if (!disk_path.empty()) {
+      disk_ = std::make_unique<DiskTable>(disk_path, disk_slots, slot_bytes);
+    }
+  }
+
+  ResultCache(const ResultCache&) = delete;
+  ResultCache& operator=(const ResultCache&) = delete;
+
+  // The cached result for key, from memory or else from disk, counting the
+  // lookup in stats().
+  std::optional<Value> find(const CacheKey& key) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (auto found = index_.find(key); found != index_.end()) {
+      ++stats_.memory_hits;
+      recency_.splice(recency_.begin(), recency_, found->second);
+      return found->second->second;
+    }
+    if (disk_) {
+      if (auto bytes = disk_->find(key)) {
+        std::string_view in(*bytes);
+        Value value;
+        if (decode(in, value) && in.empty()) {
+          ++stats_.disk_hits;
+          remember(key, value);
+          return value;
+        }
+      }
+    }
+    ++stats_.misses;
+    return std::nullopt;
+  }
+
+  // Store value as the result for key in every tier.
+  void insert(const CacheKey& key, const Value& value) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    remember(key, value);
+    if (disk_) {
+      std::string bytes;
+      encode(value, bytes);
+      disk_->store(key, bytes);
+    }
+  }
+
+  // The cached result for key, or else compute(), which is cached.
+  template <typename Compute>
+  Value get_or_compute(const CacheKey& key, Compute compute) {
+    if (auto cached = find(key)) {
+      return std::move(*cached);
+    }
+    Value value = compute();
+    insert(key, value);
+    return value;
+  }
+
+  // Number of results held in memory.
+  size_t size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return recency_.size();
+  }
+
+  bool has_disk_tier() const { return disk_ && disk_->is_open(); }
+
+  CacheStats stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+  }
+};
+
+}
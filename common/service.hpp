@@ -0,0 +1,657 @@
+///////////////////////////////////////////////////////////////////////////////
+// service.hpp
+//
+// A small resident request server over a Unix domain socket, so that many
+// processes on one host can share one warmed-up copy of the algorithms
+// instead of each paying its own startup costs.
+//
+// Requests and responses are binary frames: a fixed 16-byte FrameHeader
+// followed by a payload whose layout is defined by each operation. Both ends
+// run on the same host, so integers are in native byte order. A client may
+// pipeline many requests on one connection; responses carry the request id
+// and may arrive out of order.
+//
+// Each connection has a reader thread that receives into a shared buffer,
+// parses every complete frame in it, and submits them to a shared thread
+// pool as one batch. Handlers read their payloads in place, from views into
+// that buffer. The threads of closed connections are joined as new
+// connections arrive. Every
+// operation has a latency histogram, reported by the built-in stats
+// operation.
+//
+// How to use:
+//
+//    service::Server server("/tmp/example.sock");
+//    server.handle(1, "echo", [](service::PayloadReader& in,
+//                                service::PayloadWriter& out) {
+//      out.write_bytes(in.rest());
+//      return service::status_ok;
+//    });
+//    server.start();
+//
+//    service::Client client("/tmp/example.sock");
+//    auto [status, payload] = client.call(1, "hello");
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace service {
+
+// Header of every frame. In a request, code is the operation; in a response,
+// it is the status.
+struct FrameHeader {
+  uint32_t size;  // payload bytes following the header
+  uint16_t code;
+  uint16_t reserved;
+  uint64_t id;    // chosen by the client, echoed in the response
+};
+
+static_assert(sizeof(FrameHeader) == 16);
+
+// Largest payload a Server accepts in a request, and a Client accepts in a
+// response, unless given another limit.
+constexpr uint32_t default_max_payload = uint32_t(1) << 26;
+
+// Response statuses.
+constexpr uint16_t status_ok = 0,
+                   status_unknown_operation = 1,
+                   status_bad_request = 2;
+
+// Operation code of the built-in stats operation, whose response is a text
+// report of every operation's latency histogram.
+constexpr uint16_t stats_operation = 0;
+
+// Histogram of latencies in power-of-two buckets of microseconds: bucket 0
+// counts latencies under 1us, and bucket i counts [2^(i-1), 2^i) us. Safe to
+// record from many threads at once.
+class LatencyHistogram {
+public:
+  static constexpr size_t bucket_count = 32;
+
+private:
+  std::array<std::atomic<uint64_t>, bucket_count> buckets_{};
+  std::atomic<uint64_t> count_{0}, total_ns_{0};
+
+public:
+
+  void record(std::chrono::nanoseconds latency) {
+    const uint64_t ns = latency.count(), us = ns / 1000;
+    size_t bucket = (us == 0) ? 0 : 64 - __builtin_clzll(us);
+    bucket = std::min(bucket, bucket_count - 1);
+    buckets_[bucket].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+    total_ns_.fetch_add(ns, std::memory_order_relaxed);
+  }
+
+  uint64_t count() const { return count_.load(); }
+
+  // One line of summary, then one line per nonempty bucket.
+  void print(std::ostream& out, const std::string& name) const {
+    const uint64_t n = count();
+    out << name << ": count=" << n << ", mean="
+        << ((n == 0) ? 0.0 : total_ns_.load() / 1000.0 / n) << "us" << std::endl;
+    for (size_t i = 0; i < bucket_count; ++i) {
+      if (uint64_t in_bucket = buckets_[i].load()) {
+        out << "  <" << (uint64_t(1) << i) << "us: " << in_bucket << std::endl;
+      }
+    }
+  }
+};
+
+// A fixed set of worker threads running tasks from a shared queue, in the
+// order they were submitted.
+class ThreadPool {
+private:
+  std::mutex mutex_;
+  std::condition_variable ready_;
+  std::deque<std::function<void()>> queue_;
+  bool stopping_ = false;
+  std::vector<std::thread> workers_;
+
+public:
+
+  explicit ThreadPool(unsigned threads) {
+    for (unsigned i = 0; i < std::max(1u, threads); ++i) {
+      workers_.emplace_back([this] {
+        for (;;) {
+          std::function<void()> task;
+          {
+            std::unique_lock<std::mutex> lock(mutex_);
+            ready_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+            if (queue_.empty()) {
+              return;
+            }
+            task = std::move(queue_.front());
+            queue_.pop_front();
+          }
+          task();
+        }
+      });
+    }
+  }
+
+  // Finish every queued task, then stop the workers.
+  ~ThreadPool() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopping_ = true;
+    }
+    ready_.notify_all();
+    for (auto& worker : workers_) {
+      worker.join();
+    }
+  }
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  // Queue every task in batch, taking the lock once.
+  void submit(std::vector<std::function<void()>>&& batch) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      for (auto& task : batch) {
+        queue_.push_back(std::move(task));
+      }
+    }
+    ready_.notify_all();
+  }
+};
+
+// Sequential reads of plain values from a payload, without copying it.
+// Every read returns false, consuming nothing, when too few bytes remain.
+class PayloadReader {
+private:
+  std::string_view rest_;
+
+public:
+
+  explicit PayloadReader(std::string_view payload) : rest_(payload) {}
+
+  template <typename T>
+  bool read(T& value) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    if (rest_.size() < sizeof(T)) {
+      return false;
+    }
+    std::memcpy(&value, rest_.data(), sizeof(T));
+    rest_.remove_prefix(sizeof(T));
+    return true;
+  }
+
+  // Read every remaining byte as an array of T, which must fill them
+  // exactly.
+  template <typename T>
+  bool read_rest(std::vector<T>& values) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    if (rest_.size() % sizeof(T) != 0) {
+      return false;
+    }
+    values.resize(rest_.size() / sizeof(T));
+    std::memcpy(values.data(), rest_.data(), rest_.size());
+    rest_ = std::string_view();
+    return true;
+  }
+
+  // The bytes not yet read.
+  std::string_view rest() const { return rest_; }
+};
+
+// Sequential writes of plain values into a response payload.
+class PayloadWriter {
+private:
+  std::string bytes_;
+
+public:
+
+  template <typename T>
+  void write(const T& value) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    bytes_.append(reinterpret_cast<const char*>(&value), sizeof(T));
+  }
+
+  template <typename T>
+  void write_array(const std::vector<T>& values) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    bytes_.append(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T));
+  }
+
+  void write_bytes(std::string_view bytes) { bytes_.append(bytes); }
+
+  const std::string& bytes() const { return bytes_; }
+  std::string& bytes() { return bytes_; }
+};
+
+// Handle one request, decoding it from in and encoding the response into
+// out, and return the response status.
+using Handler = std::function<uint16_t(PayloadReader& in, PayloadWriter& out)>;
+
+namespace detail {
+
+inline bool write_frame(int fd, const FrameHeader& header, std::string_view payload) {
+  iovec parts[2] = {{const_cast<FrameHeader*>(&header), sizeof(header)},
+                    {const_cast<char*>(payload.data()), payload.size()}};
+  iovec* next = parts;
+  size_t count = 2;
+  while (count > 0) {
+    msghdr message{};
+    message.msg_iov = next;
+    message.msg_iovlen = count;
+    ssize_t sent = ::sendmsg(fd, &message, MSG_NOSIGNAL);
+    if (sent < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    // skip the parts sent in full, and trim a part sent in part
+    while (count > 0 && size_t(sent) >= next->iov_len) {
+      sent -= next->iov_len;
+      ++next;
+      --count;
+    }
+    if (count > 0) {
+      next->iov_base = static_cast<char*>(next->iov_base) + sent;
+      next->iov_len -= sent;
+    }
+  }
+  return true;
+}
+
+inline sockaddr_un socket_address(const std::string& path) {
+  sockaddr_un address{};
+  address.sun_family = AF_UNIX;
+  if (path.size() >= sizeof(address.sun_path)) {
+    throw std::system_error(ENAMETOOLONG, std::generic_category(), path);
+  }
+  std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+  return address;
+}
+
+}
+
+// Serves registered operations on a Unix domain socket.
+class Server {
+private:
+  struct Operation {
+    std::string name;
+    Handler handler;
+    LatencyHistogram latency;
+  };
+
+  // One client connection. The socket is closed once the reader and every
+  // queued task using it have finished.
+  struct Connection {
+    int fd;
+    std::mutex write_mutex;
+    explicit Connection(int fd) : fd(fd) {}
+    ~Connection() { ::close(fd); }
+  };
+
+  // Bytes received from one connection. Tasks hold views into block, and
+  // a reference to it, so a block is never written again once a batch has
+  // been submitted from it; receiving continues in a new block.
+  struct ReceiveBuffer {
+    std::shared_ptr<char[]> block;
+    size_t capacity = 0, begin = 0, end = 0;
+
+    // Move the unparsed bytes [begin, end) to the start of a block with
+    // room for at least wanted bytes. The block is reused when no task
+    // holds it and it is large enough.
+    void reserve(size_t wanted) {
+      const size_t unparsed = end - begin;
+      wanted = std::max(wanted, unparsed);
+      if (block && block.use_count() == 1 && wanted <= capacity) {
+        std::memmove(block.get(), block.get() + begin, unparsed);
+      } else {
+        std::shared_ptr<char[]> fresh(new char[wanted]);
+        if (unparsed > 0) {
+          std::memcpy(fresh.get(), block.get() + begin, unparsed);
+        }
+        block = std::move(fresh);
+        capacity = wanted;
+      }
+      begin = 0;
+      end = unparsed;
+    }
+  };
+
+  static constexpr size_t receive_chunk = size_t(1) << 16;
+
+  std::string path_;
+  std::map<uint16_t, std::unique_ptr<Operation>> operations_;
+  std::unique_ptr<ThreadPool> pool_;
+  unsigned threads_;
+  uint32_t max_payload_;
+  int listener_ = -1;
+  std::thread acceptor_;
+  std::mutex connections_mutex_;
+  std::vector<std::weak_ptr<Connection>> connections_;
+  std::map<uint64_t, std::thread> readers_;
+  std::vector<uint64_t> finished_readers_;
+  uint64_t next_reader_ = 0;
+
+  void respond(Connection& connection, uint64_t id, uint16_t status, std::string_view payload) {
+    FrameHeader header{uint32_t(payload.size()), status, 0, id};
+    std::lock_guard<std::mutex> lock(connection.write_mutex);
+    detail::write_frame(connection.fd, header, payload);
+  }
+
+  // Run one request, on a pool thread.
+  void execute(Connection& connection, const FrameHeader& header, std::string_view payload) {
+    if (header.code == stats_operation) {
+      respond(connection, header.id, status_ok, stats());
+      return;
+    }
+    auto found = operations_.find(header.code);
+    if (found == operations_.end()) {
+      respond(connection, header.id, status_unknown_operation, {});
+      return;
+    }
+    Operation& operation = *found->second;
+    auto start = std::chrono::steady_clock::now();
+    PayloadReader in(payload);
+    PayloadWriter out;
+    uint16_t status = operation.handler(in, out);
+    operation.latency.record(std::chrono::steady_clock::now() - start);
+    respond(connection, header.id, status, out.bytes());
+  }
+
+  // Read frames from one connection until it closes, submitting every
+  // complete frame received so far as one batch. A request larger than
+  // max_payload_ is answered with status_bad_request, and its payload is
+  // skipped without being stored.
+  void read_loop(std::shared_ptr<Connection> connection) {
+    ReceiveBuffer buffer;
+    size_t wanted = receive_chunk;  // bytes from begin needed to parse on
+    uint64_t skipping = 0;          // bytes of a rejected payload not yet skipped
+    for (;;) {
+      if (!buffer.block || buffer.block.use_count() > 1 || buffer.end == buffer.capacity ||
+          buffer.begin + wanted > buffer.capacity) {
+        buffer.reserve(std::max(wanted, receive_chunk));
+      }
+      ssize_t received = ::recv(connection->fd, buffer.block.get() + buffer.end,
+                                buffer.capacity - buffer.end, 0);
+      if (received < 0 && errno == EINTR) {
+        continue;
+      }
+      if (received <= 0) {
+        return;
+      }
+      buffer.end += received;
+
+      std::vector<std::function<void()>> batch;
+      wanted = receive_chunk;
+      for (;;) {
+        const size_t skipped = std::min<uint64_t>(skipping, buffer.end - buffer.begin);
+        buffer.begin += skipped;
+        skipping -= skipped;
+        FrameHeader header;
+        if (skipping > 0 || buffer.end - buffer.begin < sizeof(header)) {
+          break;
+        }
+        std::memcpy(&header, buffer.block.get() + buffer.begin, sizeof(header));
+        if (header.size > max_payload_) {
+          respond(*connection, header.id, status_bad_request, {});
+          buffer.begin += sizeof(header);
+          skipping = header.size;
+          continue;
+        }
+        if (buffer.end - buffer.begin - sizeof(header) < header.size) {
+          wanted = sizeof(header) + header.size;
+          break;
+        }
+        std::string_view payload(buffer.block.get() + buffer.begin + sizeof(header), header.size);
+        batch.push_back([this, connection, header, block = buffer.block, payload] {
+          execute(*connection, header, payload);
+        });
+        buffer.begin += sizeof(header) + header.size;
+      }
+      if (!batch.empty()) {
+        pool_->submit(std::move(batch));
+      }
+    }
+  }
+
+  // Join the reader threads that have finished, and forget the connections
+  // that have closed. Called with connections_mutex_ held.
+  void reap() {
+    for (uint64_t id : finished_readers_) {
+      readers_[id].join();
+      readers_.erase(id);
+    }
+    finished_readers_.clear();
+    connections_.erase(std::remove_if(connections_.begin(), connections_.end(),
+                                      [](const auto& weak) { return weak.expired(); }),
+                       connections_.end());
+  }
+
+  void accept_loop() {
+    for (;;) {
+      int fd = ::accept(listener_, nullptr, nullptr);
+      if (fd < 0) {
+        if (errno == EINTR || errno == ECONNABORTED) {
+          continue;
+        }
+        return;
+      }
+      auto connection = std::make_shared<Connection>(fd);
+      std::lock_guard<std::mutex> lock(connections_mutex_);
+      reap();
+      connections_.push_back(connection);
+      const uint64_t id = next_reader_++;
+      readers_.emplace(id, std::thread([this, connection, id] {
+        read_loop(connection);
+        std::lock_guard<std::mutex> lock(connections_mutex_);
+        finished_readers_.push_back(id);
+      }));
+    }
+  }
+
+public:
+
+  // Create a server for the socket at path, running requests on threads
+  // pool threads and accepting request payloads of up to max_payload bytes.
+  // Nothing is bound until start().
+  explicit Server(std::string path,
+                  unsigned threads = std::thread::hardware_concurrency(),
+                  uint32_t max_payload = default_max_payload)
+  : path_(std::move(path)), threads_(threads), max_payload_(max_payload) {}
+
+  ~Server() { stop(); }
+
+  Server(const Server&) = delete;
+  Server& operator=(const Server&) = delete;
+
+  // Register an operation. code must not be stats_operation. Operations
+  // must all be registered before start().
+  void handle(uint16_t code, std::string name, Handler handler) {
+    assert(code != stats_operation);
+    assert(!pool_);
+    auto operation = std::make_unique<Operation>();
+    operation->name = std::move(name);
+    operation->handler = std::move(handler);
+    operations_[code] = std::move(operation);
+  }
+
+  // Bind the socket, replacing any stale socket file at path, and start
+  // accepting connections in the background. Throws std::system_error when
+  // the socket cannot be created.
+  void start() {
+    sockaddr_un address = detail::socket_address(path_);
+    listener_ = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener_ < 0) {
+      throw std::system_error(errno, std::generic_category(), "socket");
+    }
+    ::unlink(path_.c_str());
+    if (::bind(listener_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 ||
+        ::listen(listener_, SOMAXCONN) < 0) {
+      int error = errno;
+      ::close(listener_);
+      listener_ = -1;
+      throw std::system_error(error, std::generic_category(), path_);
+    }
+    pool_ = std::make_unique<ThreadPool>(threads_);
+    acceptor_ = std::thread(&Server::accept_loop, this);
+  }
+
+  // Stop accepting, close every connection, finish queued requests, and
+  // remove the socket file. Safe to call more than once.
+  void stop() {
+    if (listener_ < 0) {
+      return;
+    }
+    ::shutdown(listener_, SHUT_RDWR);
+    acceptor_.join();
+    ::close(listener_);
+    listener_ = -1;
+    {
+      std::lock_guard<std::mutex> lock(connections_mutex_);
+      for (auto& weak : connections_) {
+        if (auto connection = weak.lock()) {
+          ::shutdown(connection->fd, SHUT_RDWR);
+        }
+      }
+    }
+    for (auto& [id, reader] : readers_) {
+      reader.join();
+    }
+    readers_.clear();
+    finished_readers_.clear();
+    connections_.clear();
+    pool_.reset();
+    ::unlink(path_.c_str());
+  }
+
+  // Number of reader threads not yet reaped. Finished readers are joined,
+  // and closed connections forgotten, whenever a new connection is accepted,
+  // so this stays near the number of open connections.
+  size_t readers() {
+    std::lock_guard<std::mutex> lock(connections_mutex_);
+    return readers_.size();
+  }
+
+  // Text report of every operation's latency histogram.
+  std::string stats() const {
+    std::ostringstream out;
+    for (const auto& [code, operation] : operations_) {
+      operation->latency.print(out, operation->name);
+    }
+    return out.str();
+  }
+};
+
+// A connection to a Server. Not thread safe; use one Client per thread.
+class Client {
+private:
+  int fd_;
+  uint32_t max_payload_;
+  uint64_t next_id_ = 1;
+
+  bool read_fully(char* out, size_t size) {
+    while (size > 0) {
+      ssize_t received = ::recv(fd_, out, size, 0);
+      if (received < 0 && errno == EINTR) {
+        continue;
+      }
+      if (received <= 0) {
+        return false;
+      }
+      out += received;
+      size -= received;
+    }
+    return true;
+  }
+
+public:
+
+  // Connect to the server at path, accepting response payloads of up to
+  // max_payload bytes. Throws std::system_error on failure.
+  explicit Client(const std::string& path, uint32_t max_payload = default_max_payload)
+  : max_payload_(max_payload) {
+    sockaddr_un address = detail::socket_address(path);
+    fd_ = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd_ < 0) {
+      throw std::system_error(errno, std::generic_category(), "socket");
+    }
+    if (::connect(fd_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0) {
+      int error = errno;
+      ::close(fd_);
+      throw std::system_error(error, std::generic_category(), path);
+    }
+  }
+
+  ~Client() { ::close(fd_); }
+
+  Client(const Client&) = delete;
+  Client& operator=(const Client&) = delete;
+
+  // Send a request without waiting for its response, and return its id.
+  // Throws std::system_error when the connection fails.
+  uint64_t send(uint16_t operation, std::string_view payload) {
+    FrameHeader header{uint32_t(payload.size()), operation, 0, next_id_++};
+    if (!detail::write_frame(fd_, header, payload)) {
+      throw std::system_error(errno, std::generic_category(), "send");
+    }
+    return header.id;
+  }
+
+  // Wait for the next response, in whatever order the server finishes
+  // them, as (id, status, payload). Throws std::system_error when the
+  // connection closes, or with EMSGSIZE when the payload is larger than
+  // max_payload, after which the connection is no longer usable.
+  std::tuple<uint64_t, uint16_t, std::string> receive() {
+    FrameHeader header;
+    if (!read_fully(reinterpret_cast<char*>(&header), sizeof(header))) {
+      throw std::system_error(ECONNRESET, std::generic_category(), "receive");
+    }
+    if (header.size > max_payload_) {
+      throw std::system_error(EMSGSIZE, std::generic_category(), "receive");
+    }
+    std::string payload(header.size, '\0');
+    if (!read_fully(payload.data(), header.size)) {
+      throw std::system_error(ECONNRESET, std::generic_category(), "receive");
+    }
+    return {header.id, header.code, std::move(payload)};
+  }
+
+  // Send a request and wait for its response, as (status, payload). Any
+  // earlier pipelined requests must already have been received.
+  std::pair<uint16_t, std::string> call(uint16_t operation, std::string_view payload) {
+    send(operation, payload);
+    auto [id, status, response] = receive();
+    return {status, std::move(response)};
+  }
+};
+
+}
@@ -0,0 +1,209 @@
+///////////////////////////////////////////////////////////////////////////////
+// workloads.hpp
+//
+// Input generators for the timing drivers and fuzz harnesses of both
+// projects: int and string inputs for Project-1, and int and subset sum
+// inputs for Project-2.
+//
+// Uniform random inputs only measure one point of an algorithm's performance
+// envelope. These generators produce parameterized distributions, including
+// best and worst cases, and the *_workloads() functions list named
+// generators so a harness can sweep over all of them:
+//
+//    std::mt19937 rng(0);
+//    for (auto& workload : workloads::int_workloads()) {
+//      auto input = workload.generate(n, rng);
+//      // time the algorithm on input
+//    }
+//
+// Every generator is deterministic given the state of rng.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <functional>
+#include <numeric>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace workloads {
+
+// A named input generator. generate(n, rng) returns an input of size n.
+template <typename T>
+struct Workload {
+  std::string name;
+  std::function<T(size_t, std::mt19937&)> generate;
+};
+
+// A subset sum instance: an input vector and the target to search for.
+struct SubsetSumInstance {
+  std::vector<int> input;
+  int target;
+};
+
+// n ints drawn uniformly from [lo, hi].
+std::vector<int> uniform_ints(size_t n, int lo, int hi, std::mt19937& rng) {
+  std::uniform_int_distribution<> dist(lo, hi);
+  std::vector<int> result(n);
+  for (int& x : result) {
+    x = dist(rng);
+  }
+  return result;
+}
+
+// n ints from a Zipf distribution over magnitudes 1..distinct, where
+// magnitude k has probability proportional to 1/k^exponent, each with a
+// random sign. A few values dominate, as in many real inputs.
+std::vector<int> zipfian_ints(size_t n, int distinct, double exponent, std::mt19937& rng) {
+  assert(distinct > 0);
+  std::vector<double> weights(distinct);
+  for (int k = 0; k < distinct; ++k) {
+    weights[k] = 1.0 / std::pow(k + 1, exponent);
+  }
+  std::discrete_distribution<> magnitude(weights.begin(), weights.end());
+  std::bernoulli_distribution negative(0.5);
+  std::vector<int> result(n);
+  for (int& x : result) {
+    x = (magnitude(rng) + 1) * (negative(rng) ? -1 : 1);
+  }
+  return result;
+}
+
+// n ints drawn uniformly from [lo, hi], sorted in non-decreasing order.
+std::vector<int> sorted_ints(size_t n, int lo, int hi, std::mt19937& rng) {
+  std::vector<int> result = uniform_ints(n, lo, hi, rng);
+  std::sort(result.begin(), result.end());
+  return result;
+}
+
+// n copies of value.
+std::vector<int> all_equal(size_t n, int value) {
+  return std::vector<int>(n, value);
+}
+
+// A strictly increasing sequence of n ints, with exactly dips dips (see
+// algorithms::find_dip) at random positions; no dips at all when dips == 0.
+// Dips start at multiples of 4 so that they never overlap, which requires
+// dips <= (n - 3) / 4 + 1 when n >= 3.
+std::vector<int> sparse_dips(size_t n, size_t dips, std::mt19937& rng) {
+  std::vector<int> result(n);
+  for (size_t i = 0; i < n; ++i) {
+    result[i] = 4 * int(i);
+  }
+  if (dips == 0 || n < 3) {
+    return result;
+  }
+  std::vector<size_t> slots((n - 3) / 4 + 1);
+  std::iota(slots.begin(), slots.end(), 0);
+  assert(dips <= slots.size());
+  std::shuffle(slots.begin(), slots.end(), rng);
+  for (size_t k = 0; k < dips; ++k) {
+    size_t i = 4 * slots[k];
+    result[i + 1] = result[i] - 1;
+    result[i + 2] = result[i];
+  }
+  return result;
+}
+
+// n chars drawn uniformly from [lo, hi].
+std::string uniform_chars(size_t n, char lo, char hi, std::mt19937& rng) {
+  std::uniform_int_distribution<> dist(lo, hi);
+  std::string result(n, ' ');
+  for (char& c : result) {
+    c = dist(rng);
+  }
+  return result;
+}
+
+// n chars of lower-case words separated by runs of spaces, where every run
+// of spaces is run_length long and every word is word_length letters.
+std::string space_runs(size_t n, size_t word_length, size_t run_length, std::mt19937& rng) {
+  std::uniform_int_distribution<> letter('a', 'z');
+  std::string result;
+  result.reserve(n);
+  while (result.size() < n) {
+    for (size_t i = 0; i < word_length && result.size() < n; ++i) {
+      result.push_back(letter(rng));
+    }
+    for (size_t i = 0; i < run_length && result.size() < n; ++i) {
+      result.push_back(' ');
+    }
+  }
+  return result;
+}
+
+// A subset sum instance with no solution: every element is even and the
+// target is odd, so the search cannot stop early.
+SubsetSumInstance no_solution_subset_sum(size_t n, std::mt19937& rng) {
+  std::uniform_int_distribution<> dist(-500000000, +500000000);
+  SubsetSumInstance instance{std::vector<int>(n), 1};
+  for (int& x : instance.input) {
+    x = 2 * dist(rng);
+  }
+  return instance;
+}
+
+// A subset sum instance whose only solution is the whole input: the
+// elements are distinct powers of two in shuffled order, so every subset has
+// a different sum, and the target is the sum of all of them. Exhaustive
+// searches that enumerate masks in increasing order find it last. n must be
+// at most 30.
+SubsetSumInstance late_solution_subset_sum(size_t n, std::mt19937& rng) {
+  assert(n >= 1 && n <= 30);
+  SubsetSumInstance instance{std::vector<int>(n), (1 << n) - 1};
+  for (size_t j = 0; j < n; ++j) {
+    instance.input[j] = 1 << j;
+  }
+  std::shuffle(instance.input.begin(), instance.input.end(), rng);
+  return instance;
+}
+
+// Named int vector distributions for sweeping array algorithms, from the
+// usual uniform input to best and worst cases.
+std::vector<Workload<std::vector<int>>> int_workloads() {
+  return {
+    {"uniform [-100, 100]", [](size_t n, std::mt19937& rng) { return uniform_ints(n, -100, +100, rng); }},
+    {"zipfian, s=1.2", [](size_t n, std::mt19937& rng) { return zipfian_ints(n, 100, 1.2, rng); }},
+    {"sorted", [](size_t n, std::mt19937& rng) { return sorted_ints(n, -100, +100, rng); }},
+    {"all zero", [](size_t n, std::mt19937&) { return all_equal(n, 0); }},
+    {"all negative", [](size_t n, std::mt19937&) { return all_equal(n, -1); }},
+    {"no dips", [](size_t n, std::mt19937& rng) { return sparse_dips(n, 0, rng); }},
+    {"sparse dips", [](size_t n, std::mt19937& rng) {
+      return sparse_dips(n, std::min<size_t>(8, n < 3 ? 0 : (n - 3) / 4 + 1), rng);
+    }},
+  };
+}
+
+// Named string distributions for sweeping text algorithms.
+std::vector<Workload<std::string>> string_workloads() {
+  return {
+    {"uniform printable", [](size_t n, std::mt19937& rng) { return uniform_chars(n, ' ', '~', rng); }},
+    {"words, single spaces", [](size_t n, std::mt19937& rng) { return space_runs(n, 5, 1, rng); }},
+    {"long space runs", [](size_t n, std::mt19937& rng) { return space_runs(n, 2, 64, rng); }},
+    {"all spaces", [](size_t n, std::mt19937&) { return std::string(n, ' '); }},
+    {"all lower-case", [](size_t n, std::mt19937& rng) { return uniform_chars(n, 'a', 'z', rng); }},
+  };
+}
+
+// Named subset sum distributions.
+std::vector<Workload<SubsetSumInstance>> subset_sum_workloads() {
+  return {
+    {"uniform, target 1", [](size_t n, std::mt19937& rng) {
+      return SubsetSumInstance{uniform_ints(n, -1000000000, +1000000000, rng), 1};
+    }},
+    {"no solution", [](size_t n, std::mt19937& rng) { return no_solution_subset_sum(n, rng); }},
+    {"late solution", [](size_t n, std::mt19937& rng) { return late_solution_subset_sum(n, rng); }},
+    {"small positive, target half", [](size_t n, std::mt19937& rng) {
+      auto input = uniform_ints(n, 1, 100, rng);
+      int target = std::accumulate(input.begin(), input.end(), 0) / 2;
+      return SubsetSumInstance{input, target};
+    }},
+  };
+}
+
+} // namespace workloads